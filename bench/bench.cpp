@@ -0,0 +1,1100 @@
+#include <QtTest>
+#include <QtWidgets>
+#include <QtXml>
+#include <cmath>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+#include "buttonsdelegate.h"
+#include "chunkedlist.h"
+#include "fuzzymatcher.h"
+#include "sortfilterproxymodel.h"
+#include "textmatcher.h"
+#include "treemodel.h"
+#include "treewidget.h"
+
+// catalogs
+///////////////////////////////////////////////////////////////////////////////
+// wide: brands with about sqrt(size) models each,
+// deep: chains of DEEP_LENGTH items,
+// skewed: brand i has about 1 / (i + 1) of the models
+enum Shape { WIDE, DEEP, SKEWED, SHAPE_COUNT };
+
+enum { DEEP_LENGTH = 1000 };
+enum { SKEWED_BRANDS = 100 };
+enum { MAX_NODES = 1000000 };
+
+// positions of a changed row among its siblings
+enum Position { HEAD, MIDDLE, TAIL, POSITION_COUNT };
+
+const char* shapeName(int shape) {
+	static const char* names[] = { "wide", "deep", "skewed" };
+	return names[shape];
+}
+
+const char* positionName(int position) {
+	static const char* names[] = { "head", "middle", "tail" };
+	return names[position];
+}
+
+// the largest catalog, the variable limits it for quick runs
+int maxNodes() {
+	auto isValid = false;
+	auto value = qEnvironmentVariableIntValue("CARBRANDS_BENCH_MAX_NODES", &isValid);
+	return (isValid && value > 0) ? value : int(MAX_NODES);
+}
+
+QVector<int> catalogSizes() {
+	QVector<int> sizes;
+	for (int size = 10000; size <= maxNodes(); size *= 10) {
+		sizes.push_back(size);
+	}
+	return sizes;
+}
+
+// labels are unique, so any sibling lists can be built of them
+QString label(int i) {
+	static const char* words[] = {
+		"alfa", "bravo", "charlie", "delta", "echo", "foxtrot", "golf",
+		"hotel", "india", "juliett", "kilo", "lima", "mike", "november"
+	};
+	return QString("%1 %2").arg(words[i % (sizeof(words) / sizeof(words[0]))]).arg(i);
+}
+
+// nodes of catalog in pre-order, as TreeModel::insertSubtree takes them
+QVector<TreeModel::Node> catalog(Shape shape, int size) {
+	QVector<TreeModel::Node> nodes;
+	nodes.reserve(size);
+
+	switch (shape) {
+	case WIDE: {
+		auto models = qMax(1, int(std::sqrt(double(size))));
+		for (int i = 0; i < size; ++i) {
+			nodes.push_back({ label(i), (i % (models + 1) == 0) ? 0 : 1 });
+		}
+		break;
+	}
+	case DEEP:
+		for (int i = 0; i < size; ++i) {
+			nodes.push_back({ label(i), i % DEEP_LENGTH });
+		}
+		break;
+	case SKEWED: {
+		auto harmonic = 0.0;
+		for (int brand = 0; brand < SKEWED_BRANDS; ++brand) {
+			harmonic += 1.0 / (brand + 1);
+		}
+
+		for (int brand = 0; brand < SKEWED_BRANDS && nodes.size() < size; ++brand) {
+			nodes.push_back({ label(nodes.size()), 0 });
+			auto models = int(size / harmonic / (brand + 1));
+			for (int i = 0; i < models && nodes.size() < size; ++i) {
+				nodes.push_back({ label(nodes.size()), 1 });
+			}
+		}
+
+		// the rest of rounding goes to the last brand
+		while (nodes.size() < size) {
+			nodes.push_back({ label(nodes.size()), 1 });
+		}
+		break;
+	}
+	default:
+		break;
+	}
+	return nodes;
+}
+
+// model with catalog, search index is enabled as by TreeWidget
+TreeModel* createModel(Shape shape, int size) {
+	auto model = new TreeModel();
+	model->setSearchIndexEnabled(true);
+	model->insertSubtree(QModelIndex(), 0, catalog(shape, size));
+	return model;
+}
+
+// indexes of all items in pre-order
+QVector<QModelIndex> allIndexes(const QAbstractItemModel& model) {
+	QVector<QModelIndex> indexes;
+	QVector<QModelIndex> parents(1, QModelIndex());
+	while (!parents.isEmpty()) {
+		auto parent = parents.takeLast();
+		for (int row = model.rowCount(parent) - 1; row >= 0; --row) {
+			parents.push_back(model.index(row, 0, parent));
+		}
+		if (parent.isValid()) {
+			indexes.push_back(parent);
+		}
+	}
+	return indexes;
+}
+
+// parent with the most children
+QModelIndex widestParent(const QAbstractItemModel& model) {
+	QModelIndex widest;
+	auto width = model.rowCount();
+	for (auto& index : allIndexes(model)) {
+		auto count = model.rowCount(index);
+		if (count > width) {
+			widest = index;
+			width = count;
+		}
+	}
+	return widest;
+}
+
+void addCatalogColumns() {
+	QTest::addColumn<int>("shape");
+	QTest::addColumn<int>("size");
+}
+
+void addCatalogRows() {
+	addCatalogColumns();
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		for (auto size : catalogSizes()) {
+			QTest::newRow(qPrintable(QString("%1/%2").arg(shapeName(shape)).arg(size)))
+				<< shape << size;
+		}
+	}
+}
+
+// model, which counts calls of parent(), views make them for each painted row
+class CountingTreeModel : public TreeModel
+{
+public:
+	CountingTreeModel() : parentCalls(0) {}
+
+	QModelIndex parent(const QModelIndex& index) const Q_DECL_OVERRIDE {
+		++parentCalls;
+		return TreeModel::parent(index);
+	}
+
+	mutable qint64 parentCalls;
+};
+
+// expanded catalog in a tree view with the delegate and proxy of TreeWidget,
+// filtered by text, if it is not empty
+class ScrollView
+{
+public:
+	enum { SIZE = 100000 };
+	enum { FRAMES = 100 };
+
+	ScrollView(Shape shape, const QString& filterText) : model(), proxy(nullptr), view() {
+		model.setSearchIndexEnabled(true);
+		model.insertSubtree(QModelIndex(), 0, catalog(shape, qMin(int(SIZE), maxNodes())));
+		proxy.setSourceModel(&model);
+		proxy.setCandidateFinder([this](const QRegExp& regExp, QModelIndexList* indexes) {
+			return regExp.patternSyntax() == QRegExp::FixedString
+				&& model.findIndexes(regExp.pattern(), indexes);
+		});
+		proxy.setFilterCaseSensitivity(Qt::CaseInsensitive);
+		proxy.setFilterKeyColumn(0);
+		proxy.setFilterFixedString(filterText);
+
+		view.setUniformRowHeights(true);
+		view.setHeaderHidden(true);
+		view.setItemDelegate(new ButtonsDelegate(QSize(16, 16), &view));
+		view.setModel(&proxy);
+		view.resize(260, 367);
+		view.expandAll();
+		view.show();
+	}
+
+	// the view is scrolled through the tree by FRAMES steps, each one is painted
+	void scroll() {
+		auto bar = view.verticalScrollBar();
+		for (int frame = 0; frame < FRAMES; ++frame) {
+			bar->setValue(int(qint64(bar->maximum()) * frame / FRAMES));
+			view.viewport()->repaint();
+		}
+	}
+
+	CountingTreeModel model;
+	SortFilterProxyModel proxy;
+	QTreeView view;
+};
+
+void addShapeRows() {
+	QTest::addColumn<int>("shape");
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		QTest::newRow(shapeName(shape)) << shape;
+	}
+}
+
+// sibling lists of one parent: the chunked list of TreeItem and the list
+// with renumbered hash of rows, which TreeItem had before it
+struct ChunkedSibling {
+	QString data;
+	ChunkedList<ChunkedSibling>::Position position_;
+};
+
+class ChunkedSiblings
+{
+public:
+	explicit ChunkedSiblings(int count) : items_(), unique_() {
+		for (int i = 0; i < count; ++i) {
+			insert(label(i), i);
+		}
+	}
+
+	~ChunkedSiblings() {
+		items_.forEach([](ChunkedSibling* item) { delete item; });
+	}
+
+	bool insert(const QString& data, int pos) {
+		if (unique_.contains(data)) {
+			return false;
+		}
+
+		auto item = new ChunkedSibling{ data, ChunkedList<ChunkedSibling>::Position() };
+		items_.insert(pos, item);
+		unique_.insert(data, item);
+		return true;
+	}
+
+	void remove(int pos) {
+		auto item = items_.take(pos);
+		unique_.remove(item->data);
+		delete item;
+	}
+
+	int row(const QString& data) const {
+		auto item = unique_.value(data, nullptr);
+		return (item) ? ChunkedList<ChunkedSibling>::row(item->position_) : -1;
+	}
+
+private:
+	ChunkedList<ChunkedSibling> items_;
+	QHash<QString, ChunkedSibling*> unique_;
+};
+
+class ListSiblings
+{
+public:
+	explicit ListSiblings(int count) : items_(), unique_() {
+		for (int i = 0; i < count; ++i) {
+			insert(label(i), i);
+		}
+	}
+
+	bool insert(const QString& data, int pos) {
+		if (unique_.contains(data)) {
+			return false;
+		}
+
+		unique_[data] = pos;
+		for (int i = pos; i < items_.size(); ++i) {
+			unique_[items_[i]] = i + 1;
+		}
+		items_.insert(pos, data);
+		return true;
+	}
+
+	void remove(int pos) {
+		for (int i = pos + 1; i < items_.size(); ++i) {
+			unique_[items_[i]] = i - 1;
+		}
+		unique_.remove(items_.takeAt(pos));
+	}
+
+	int row(const QString& data) const {
+		return unique_.value(data, -1);
+	}
+
+private:
+	QList<QString> items_;
+	QHash<QString, int> unique_;
+};
+
+// insert and remove of one sibling at pos, the row of the last sibling is read after insert
+template <typename Siblings>
+void insertSibling(Siblings& siblings, int pos, const QString& last) {
+	QVERIFY(siblings.insert("inserted", pos));
+	QVERIFY(siblings.row(last) >= 0);
+	siblings.remove(pos);
+}
+
+// resident memory of the process in bytes, 0 if it is unknown
+#if defined(Q_OS_LINUX)
+qint64 procStatusBytes(const QByteArray& field) {
+	QFile file("/proc/self/status");
+	if (!file.open(QIODevice::ReadOnly)) {
+		return 0;
+	}
+
+	for (auto line = file.readLine(); !line.isEmpty(); line = file.readLine()) {
+		if (line.startsWith(field)) {
+			auto kilobytes = line.mid(field.size()).simplified().split(' ').value(0);
+			return kilobytes.toLongLong() * 1024;
+		}
+	}
+	return 0;
+}
+#endif
+
+qint64 residentBytes() {
+#if defined(Q_OS_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	return (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		? qint64(counters.WorkingSetSize)
+		: 0;
+#elif defined(Q_OS_LINUX)
+	return procStatusBytes("VmRSS:");
+#else
+	return 0;
+#endif
+}
+
+// freed heap is returned to the system, so the next reading starts from the live memory
+void trimHeap() {
+#if defined(__GLIBC__)
+	malloc_trim(0);
+#endif
+}
+
+// item as TreeItem was before the pool: each one is a separate allocation
+// with its own hash and list, children are deleted by their parent
+class HeapItem
+{
+public:
+	HeapItem(HeapItem* parent, const QString& data)
+		: unique_(), children_(), data_(data), parent_(parent) {}
+
+	~HeapItem() {
+		qDeleteAll(children_);
+	}
+
+	HeapItem* append(const QString& data) {
+		unique_[data] = children_.size();
+		children_.push_back(new HeapItem(this, data));
+		return children_.last();
+	}
+
+	HeapItem* parent() const {
+		return parent_;
+	}
+
+private:
+	QHash<QString, int> unique_;
+	QList<HeapItem*> children_;
+	QString data_;
+	HeapItem* parent_;
+};
+
+HeapItem* createHeapTree(const QVector<TreeModel::Node>& nodes) {
+	auto root = new HeapItem(nullptr, QString());
+	QVector<HeapItem*> parents(1, root);
+	for (auto& node : nodes) {
+		parents.resize(node.depth + 1);
+		parents.push_back(parents[node.depth]->append(node.data));
+	}
+	return root;
+}
+
+// catalog of the largest size, built by the pool of TreeModel or by heap items
+class StoredCatalog
+{
+public:
+	StoredCatalog(const QVector<TreeModel::Node>& nodes, bool isPool)
+		: model_(), heapRoot_() {
+		if (isPool) {
+			model_.reset(new TreeModel());
+			model_->insertSubtree(QModelIndex(), 0, nodes);
+		}
+		else {
+			heapRoot_.reset(createHeapTree(nodes));
+		}
+	}
+
+private:
+	QScopedPointer<TreeModel> model_;
+	QScopedPointer<HeapItem> heapRoot_;
+};
+
+void addStorageRows() {
+	QTest::addColumn<int>("shape");
+	QTest::addColumn<bool>("isPool");
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		for (auto isPool : { true, false }) {
+			QTest::newRow(qPrintable(QString("%1/%2/%3")
+				.arg(shapeName(shape)).arg(maxNodes()).arg((isPool) ? "pool" : "heap")))
+				<< shape << isPool;
+		}
+	}
+}
+
+// the most resident memory of the process in bytes since the last
+// resetPeakResident(), or since start, if it can not be reset; 0 if unknown
+qint64 peakResidentBytes() {
+#if defined(Q_OS_WIN)
+	PROCESS_MEMORY_COUNTERS counters;
+	return (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		? qint64(counters.PeakWorkingSetSize)
+		: 0;
+#elif defined(Q_OS_LINUX)
+	return procStatusBytes("VmHWM:");
+#else
+	return 0;
+#endif
+}
+
+// the peak is reset to the current resident memory, on Linux only
+void resetPeakResident() {
+#if defined(Q_OS_LINUX)
+	QFile file("/proc/self/clear_refs");
+	if (file.open(QIODevice::WriteOnly)) {
+		file.write("5");
+	}
+#endif
+}
+
+// xml of catalog in a temporary file, as tree.xml is saved
+class XmlCatalog
+{
+public:
+	XmlCatalog(Shape shape, int size) : file_() {
+		QScopedPointer<TreeModel> model(createModel(shape, size));
+		if (file_.open()) {
+			model->serialize(&file_);
+			file_.close();
+		}
+	}
+
+	QString fileName() const {
+		return file_.fileName();
+	}
+
+private:
+	QTemporaryFile file_;
+};
+
+// xml is loaded by the streaming reader of TreeModel or, as before it,
+// decoded to a string, parsed to a document and walked
+void insertDomItems(TreeModel* model, const QDomElement& parentItem, const QModelIndex& parent) {
+	const QString itemTag(QStringLiteral("item"));
+	int row = 0;
+	for (auto item = parentItem.firstChildElement(itemTag); !item.isNull();
+		item = item.nextSiblingElement(itemTag), ++row) {
+		auto index = model->insert(item.firstChild().toCDATASection().data(), row, parent);
+		if (index.isValid()) {
+			insertDomItems(model, item, index);
+		}
+	}
+}
+
+bool loadXml(TreeModel* model, const QString& fileName, bool isStream) {
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	if (isStream) {
+		return model->deserialize(&file);
+	}
+
+	QDomDocument document;
+	if (!document.setContent(QString::fromUtf8(file.readAll()))) {
+		return false;
+	}
+	insertDomItems(model, document.documentElement(), QModelIndex());
+	return true;
+}
+
+void addXmlLoadRows() {
+	addCatalogColumns();
+	QTest::addColumn<bool>("isStream");
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		for (auto size : catalogSizes()) {
+			for (auto isStream : { true, false }) {
+				QTest::newRow(qPrintable(QString("%1/%2/%3")
+					.arg(shapeName(shape)).arg(size).arg((isStream) ? "stream" : "dom")))
+					<< shape << size << isStream;
+			}
+		}
+	}
+}
+
+// ways to open the saved tree at startup
+enum Startup { XML_STARTUP, SNAPSHOT_STARTUP, LAZY_STARTUP, STARTUP_COUNT };
+
+const char* startupName(int startup) {
+	static const char* names[] = { "xml", "snapshot", "lazy" };
+	return names[startup];
+}
+
+// snapshot of catalog in a temporary file, as MainWidget saves it
+class SnapshotCatalog
+{
+public:
+	SnapshotCatalog(Shape shape, int size) : file_() {
+		QScopedPointer<TreeModel> model(createModel(shape, size));
+		if (file_.open()) {
+			model->writeSnapshot(&file_);
+			file_.close();
+		}
+	}
+
+	QString fileName() const {
+		return file_.fileName();
+	}
+
+private:
+	QTemporaryFile file_;
+};
+
+// cyrillic "Patriot" by code points, as sources are kept in ascii,
+// capitalized in labels and in mixed case in the filter text
+QString cyrillicWord(bool isMixedCase) {
+	static const ushort word[] = { 0x041f, 0x0430, 0x0442, 0x0440, 0x0438, 0x043e, 0x0442 };
+	static const ushort mixedCaseWord[] = { 0x043f, 0x0410, 0x0422, 0x0420, 0x0418, 0x041e, 0x0422 };
+	return QString::fromUtf16((isMixedCase) ? mixedCaseWord : word, 7);
+}
+
+// labels for the filter: latin ones of the catalog and cyrillic ones,
+// with surrounding spaces, which the filter ignores
+QVector<QString> matchLabels(int size) {
+	QVector<QString> labels;
+	labels.reserve(size);
+	for (int i = 0; i < size; ++i) {
+		labels.push_back((i % 2 == 0) ? label(i) : QString(" %1 %2 ").arg(cyrillicWord(false)).arg(i));
+	}
+	return labels;
+}
+
+// number of labels, which contain text case insensitive, by TextMatcher
+// or, as the proxy did before it, by a fixed string QRegExp over trimmed copies
+int countMatches(const QVector<QString>& labels, const QString& text, bool isMatcher) {
+	int count = 0;
+	if (isMatcher) {
+		TextMatcher matcher(text);
+		for (auto& data : labels) {
+			count += (matcher.contains(data)) ? 1 : 0;
+		}
+	}
+	else {
+		QRegExp regExp(text, Qt::CaseInsensitive, QRegExp::FixedString);
+		for (auto& data : labels) {
+			count += (data.trimmed().contains(regExp)) ? 1 : 0;
+		}
+	}
+	return count;
+}
+
+// benchmarks
+///////////////////////////////////////////////////////////////////////////////
+class TreeBenchmark : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void build_data();
+	void build();
+	void insertRemove_data();
+	void insertRemove();
+	void serialize_data();
+	void serialize();
+	void deserialize_data();
+	void deserialize();
+	void filterKeystrokes_data();
+	void filterKeystrokes();
+	void parentIndexStorm_data();
+	void parentIndexStorm();
+	void scroll_data();
+	void scroll();
+	void scrollLookups_data();
+	void scrollLookups();
+	void siblingInsert_data();
+	void siblingInsert();
+	void buildTeardown_data();
+	void buildTeardown();
+	void memoryPerNode_data();
+	void memoryPerNode();
+	void xmlLoad_data();
+	void xmlLoad();
+	void xmlLoadPeak_data();
+	void xmlLoadPeak();
+	void startup_data();
+	void startup();
+	void textMatch_data();
+	void textMatch();
+	void fuzzyRank_data();
+	void fuzzyRank();
+};
+
+void TreeBenchmark::build_data() {
+	addCatalogRows();
+}
+
+// items are inserted into a new model and destroyed with it
+void TreeBenchmark::build() {
+	QFETCH(int, shape);
+	QFETCH(int, size);
+
+	auto nodes = catalog(Shape(shape), size);
+	QBENCHMARK {
+		TreeModel model;
+		model.setSearchIndexEnabled(true);
+		QVERIFY(model.insertSubtree(QModelIndex(), 0, nodes));
+	}
+}
+
+void TreeBenchmark::insertRemove_data() {
+	addCatalogColumns();
+	QTest::addColumn<int>("position");
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		for (auto size : catalogSizes()) {
+			for (int position = 0; position < POSITION_COUNT; ++position) {
+				QTest::newRow(qPrintable(QString("%1/%2/%3")
+					.arg(shapeName(shape)).arg(size).arg(positionName(position))))
+					<< shape << size << position;
+			}
+		}
+	}
+}
+
+// one row is inserted into the longest sibling list and removed
+void TreeBenchmark::insertRemove() {
+	QFETCH(int, shape);
+	QFETCH(int, size);
+	QFETCH(int, position);
+
+	QScopedPointer<TreeModel> model(createModel(Shape(shape), size));
+	auto parent = widestParent(*model);
+	auto count = model->rowCount(parent);
+	auto row = (position == HEAD) ? 0 : (position == MIDDLE) ? count / 2 : count;
+
+	QBENCHMARK {
+		QVERIFY(model->insert("inserted", row, parent).isValid());
+		QVERIFY(model->removeRow(row, parent));
+	}
+}
+
+void TreeBenchmark::serialize_data() {
+	addCatalogRows();
+}
+
+void TreeBenchmark::serialize() {
+	QFETCH(int, shape);
+	QFETCH(int, size);
+
+	QScopedPointer<TreeModel> model(createModel(Shape(shape), size));
+	QBENCHMARK {
+		QBuffer buffer;
+		buffer.open(QIODevice::WriteOnly);
+		QVERIFY(model->serialize(&buffer));
+	}
+}
+
+void TreeBenchmark::deserialize_data() {
+	addCatalogRows();
+}
+
+void TreeBenchmark::deserialize() {
+	QFETCH(int, shape);
+	QFETCH(int, size);
+
+	QByteArray data;
+	{
+		QScopedPointer<TreeModel> model(createModel(Shape(shape), size));
+		data = model->serialize();
+	}
+
+	QBENCHMARK {
+		TreeModel model;
+		QVERIFY(model.deserialize(data));
+	}
+}
+
+void TreeBenchmark::filterKeystrokes_data() {
+	addCatalogRows();
+}
+
+// a label is typed key by key and cleared, the proxy finds candidates
+// by the search index of model, as in TreeWidget
+void TreeBenchmark::filterKeystrokes() {
+	QFETCH(int, shape);
+	QFETCH(int, size);
+
+	QScopedPointer<TreeModel> model(createModel(Shape(shape), size));
+	SortFilterProxyModel proxy(nullptr);
+	proxy.setSourceModel(model.data());
+	proxy.setCandidateFinder([&model](const QRegExp& regExp, QModelIndexList* indexes) {
+		return regExp.patternSyntax() == QRegExp::FixedString
+			&& model->findIndexes(regExp.pattern(), indexes);
+	});
+	proxy.setFilterCaseSensitivity(Qt::CaseInsensitive);
+	proxy.setFilterKeyColumn(0);
+
+	auto text = label(size / 2);
+	QBENCHMARK {
+		for (int i = 1; i <= text.size(); ++i) {
+			proxy.setFilterFixedString(text.left(i));
+			QVERIFY(proxy.rowCount() > 0);
+		}
+		proxy.setFilterFixedString(QString());
+		QVERIFY(proxy.rowCount() > 0);
+	}
+}
+
+void TreeBenchmark::parentIndexStorm_data() {
+	addCatalogColumns();
+	QTest::addColumn<bool>("isProxy");
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		for (auto size : catalogSizes()) {
+			for (auto isProxy : { false, true }) {
+				QTest::newRow(qPrintable(QString("%1/%2/%3")
+					.arg(shapeName(shape)).arg(size).arg((isProxy) ? "proxy" : "model")))
+					<< shape << size << isProxy;
+			}
+		}
+	}
+}
+
+// parent() and index() of every item, as views call them while painting
+void TreeBenchmark::parentIndexStorm() {
+	QFETCH(int, shape);
+	QFETCH(int, size);
+	QFETCH(bool, isProxy);
+
+	QScopedPointer<TreeModel> model(createModel(Shape(shape), size));
+	SortFilterProxyModel proxy(nullptr);
+	proxy.setSourceModel(model.data());
+
+	QAbstractItemModel* target = (isProxy) ? static_cast<QAbstractItemModel*>(&proxy) : model.data();
+	auto indexes = allIndexes(*target);
+
+	QBENCHMARK {
+		qint64 rows = 0;
+		for (auto& index : indexes) {
+			auto parent = target->parent(index);
+			rows += target->index(index.row(), 0, parent).row();
+		}
+		QVERIFY(rows >= 0);
+	}
+}
+
+void TreeBenchmark::scroll_data() {
+	addShapeRows();
+}
+
+// time of ScrollView::FRAMES painted frames
+void TreeBenchmark::scroll() {
+	QFETCH(int, shape);
+
+	ScrollView scrollView(static_cast<Shape>(shape), QString());
+	QVERIFY(QTest::qWaitForWindowExposed(&scrollView.view));
+
+	QBENCHMARK {
+		scrollView.scroll();
+	}
+}
+
+void TreeBenchmark::scrollLookups_data() {
+	QTest::addColumn<int>("shape");
+	QTest::addColumn<QString>("lookup");
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		for (auto lookup : { "parent", "cache" }) {
+			QTest::newRow(qPrintable(QString("%1/%2").arg(shapeName(shape)).arg(lookup)))
+				<< shape << QString(lookup);
+		}
+	}
+}
+
+// lookups per painted frame: calls of TreeModel::parent() without filter or
+// lookups of the filter cache of proxy, which is the hash left on this path,
+// with a filter, which matches a part of labels
+void TreeBenchmark::scrollLookups() {
+	QFETCH(int, shape);
+	QFETCH(QString, lookup);
+
+	auto isParent = lookup == "parent";
+	ScrollView scrollView(static_cast<Shape>(shape), (isParent) ? QString() : QString("a"));
+	QVERIFY(QTest::qWaitForWindowExposed(&scrollView.view));
+
+	Instrumentation::setEnabled(true);
+	Instrumentation::reset();
+	scrollView.model.parentCalls = 0;
+
+	scrollView.scroll();
+
+	auto count = (isParent)
+		? quint64(scrollView.model.parentCalls)
+		: Instrumentation::counter(Instrumentation::CACHE_HIT) + Instrumentation::counter(Instrumentation::CACHE_MISS);
+	Instrumentation::setEnabled(false);
+
+	QTest::setBenchmarkResult(qreal(count) / ScrollView::FRAMES, QTest::Events);
+}
+
+void TreeBenchmark::siblingInsert_data() {
+	QTest::addColumn<bool>("isChunked");
+	QTest::addColumn<int>("count");
+	QTest::addColumn<int>("position");
+	for (auto isChunked : { true, false }) {
+		for (auto count : { 1000, 20000, 200000 }) {
+			if (count > maxNodes()) {
+				continue;
+			}
+			for (int position = 0; position < POSITION_COUNT; ++position) {
+				QTest::newRow(qPrintable(QString("%1/%2/%3")
+					.arg((isChunked) ? "chunked" : "list").arg(count).arg(positionName(position))))
+					<< isChunked << count << position;
+			}
+		}
+	}
+}
+
+// one sibling is inserted at the front, middle or back of count siblings and
+// removed, by the chunked list of TreeItem and by the renumbered list before it
+void TreeBenchmark::siblingInsert() {
+	QFETCH(bool, isChunked);
+	QFETCH(int, count);
+	QFETCH(int, position);
+
+	auto pos = (position == HEAD) ? 0 : (position == MIDDLE) ? count / 2 : count;
+	auto last = label(count - 1);
+
+	if (isChunked) {
+		ChunkedSiblings siblings(count);
+		QBENCHMARK {
+			insertSibling(siblings, pos, last);
+		}
+	}
+	else {
+		ListSiblings siblings(count);
+		QBENCHMARK {
+			insertSibling(siblings, pos, last);
+		}
+	}
+}
+
+void TreeBenchmark::buildTeardown_data() {
+	QTest::addColumn<int>("shape");
+	QTest::addColumn<bool>("isPool");
+	QTest::addColumn<bool>("isBuild");
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		for (auto isPool : { true, false }) {
+			for (auto isBuild : { true, false }) {
+				QTest::newRow(qPrintable(QString("%1/%2/%3/%4")
+					.arg(shapeName(shape)).arg(maxNodes())
+					.arg((isPool) ? "pool" : "heap").arg((isBuild) ? "build" : "teardown")))
+					<< shape << isPool << isBuild;
+			}
+		}
+	}
+}
+
+// build or teardown of the largest catalog by the pool of TreeModel
+// and by heap items, as TreeItem was before it
+void TreeBenchmark::buildTeardown() {
+	QFETCH(int, shape);
+	QFETCH(bool, isPool);
+	QFETCH(bool, isBuild);
+
+	auto nodes = catalog(Shape(shape), maxNodes());
+	if (isBuild) {
+		QBENCHMARK_ONCE {
+			StoredCatalog stored(nodes, isPool);
+			Q_UNUSED(stored);
+		}
+	}
+	else {
+		QScopedPointer<StoredCatalog> stored(new StoredCatalog(nodes, isPool));
+		QBENCHMARK_ONCE {
+			stored.reset();
+		}
+	}
+}
+
+void TreeBenchmark::memoryPerNode_data() {
+	addStorageRows();
+}
+
+// growth of resident memory by the largest catalog per node, label texts
+// are shared with the catalog, so this is the memory of items and their links
+void TreeBenchmark::memoryPerNode() {
+	QFETCH(int, shape);
+	QFETCH(bool, isPool);
+
+	auto nodes = catalog(Shape(shape), maxNodes());
+	trimHeap();
+	auto before = residentBytes();
+	if (before == 0) {
+		QSKIP("resident memory is unknown on this platform");
+	}
+
+	StoredCatalog stored(nodes, isPool);
+	auto after = residentBytes();
+
+	QTest::setBenchmarkResult(qreal(after - before) / nodes.size(), QTest::BytesAllocated);
+}
+
+void TreeBenchmark::xmlLoad_data() {
+	addXmlLoadRows();
+}
+
+// load of tree.xml from file by the streaming reader and by the document before it
+void TreeBenchmark::xmlLoad() {
+	QFETCH(int, shape);
+	QFETCH(int, size);
+	QFETCH(bool, isStream);
+
+	XmlCatalog xml(Shape(shape), size);
+	QBENCHMARK {
+		TreeModel model;
+		QVERIFY(loadXml(&model, xml.fileName(), isStream));
+	}
+}
+
+void TreeBenchmark::xmlLoadPeak_data() {
+	addXmlLoadRows();
+}
+
+// growth of the peak resident memory by the load, the model stays loaded,
+// on Windows the peak can not be reset, so the function is run alone
+void TreeBenchmark::xmlLoadPeak() {
+	QFETCH(int, shape);
+	QFETCH(int, size);
+	QFETCH(bool, isStream);
+
+	XmlCatalog xml(Shape(shape), size);
+	trimHeap();
+	resetPeakResident();
+	auto before = residentBytes();
+	if (before == 0) {
+		QSKIP("resident memory is unknown on this platform");
+	}
+
+	TreeModel model;
+	QVERIFY(loadXml(&model, xml.fileName(), isStream));
+
+	QTest::setBenchmarkResult(qMax(qint64(0), peakResidentBytes() - before), QTest::BytesAllocated);
+}
+
+void TreeBenchmark::startup_data() {
+	QTest::addColumn<int>("shape");
+	QTest::addColumn<int>("startup");
+	for (int shape = 0; shape < SHAPE_COUNT; ++shape) {
+		for (int startup = 0; startup < STARTUP_COUNT; ++startup) {
+			QTest::newRow(qPrintable(QString("%1/%2/%3")
+				.arg(shapeName(shape)).arg(maxNodes()).arg(startupName(startup))))
+				<< shape << startup;
+		}
+	}
+}
+
+// the largest catalog is opened until its top level rows can be shown: from
+// tree.xml, from the mapped snapshot, which is read whole, or lazily from it
+void TreeBenchmark::startup() {
+	QFETCH(int, shape);
+	QFETCH(int, startup);
+
+	XmlCatalog xml(Shape(shape), maxNodes());
+	SnapshotCatalog snapshot(Shape(shape), maxNodes());
+
+	TreeModel model;
+	QBENCHMARK_ONCE {
+		switch (startup) {
+		case XML_STARTUP:
+			QVERIFY(loadXml(&model, xml.fileName(), true));
+			break;
+		case SNAPSHOT_STARTUP: {
+			QFile file(snapshot.fileName());
+			QVERIFY(file.open(QIODevice::ReadOnly));
+			QVERIFY(model.readSnapshot(&file));
+			break;
+		}
+		case LAZY_STARTUP:
+			QVERIFY(model.openSnapshot(snapshot.fileName()));
+			break;
+		default:
+			break;
+		}
+		QVERIFY(model.rowCount() > 0);
+	}
+}
+
+void TreeBenchmark::textMatch_data() {
+	QTest::addColumn<bool>("isMatcher");
+	QTest::addColumn<QString>("text");
+	auto texts = {
+		qMakePair(QString("ECHO 12"), QString("latin")),
+		qMakePair(cyrillicWord(true) + " 7", QString("cyrillic")),
+		qMakePair(QString("zulu"), QString("missing"))
+	};
+	for (auto isMatcher : { true, false }) {
+		for (auto& text : texts) {
+			QTest::newRow(qPrintable(QString("%1/%2")
+				.arg((isMatcher) ? "matcher" : "regexp").arg(text.second)))
+				<< isMatcher << text.first;
+		}
+	}
+}
+
+// labels of the largest catalog are filtered by one text, both ways find the same labels
+void TreeBenchmark::textMatch() {
+	QFETCH(bool, isMatcher);
+	QFETCH(QString, text);
+
+	auto labels = matchLabels(maxNodes());
+	auto expected = countMatches(labels, text, !isMatcher);
+
+	QBENCHMARK {
+		QCOMPARE(countMatches(labels, text, isMatcher), expected);
+	}
+}
+
+void TreeBenchmark::fuzzyRank_data() {
+	QTest::addColumn<int>("size");
+	for (auto size : catalogSizes()) {
+		QTest::newRow(qPrintable(QString::number(size))) << size;
+	}
+}
+
+// labels of a catalog are ranked by a misspelled label on all cores, as TreeWidget
+// does in fuzzy mode, the best TreeWidget::FUZZY_LIMIT items are kept
+void TreeBenchmark::fuzzyRank() {
+	QFETCH(int, size);
+
+	QScopedPointer<TreeModel> model(createModel(WIDE, size));
+	auto labels = model->labelSnapshot();
+
+	auto i = size / 3;
+	while (!label(i).startsWith("charlie")) {
+		++i;
+	}
+	auto text = QString("chralie %1").arg(i);
+
+	QBENCHMARK {
+		auto ranking = rankLabels(text, { labels }, TreeWidget::FUZZY_LIMIT).result();
+		QVERIFY(ranking.size() > 0);
+		QCOMPARE(ranking.matches().first().text, label(i));
+	}
+}
+
+// main
+///////////////////////////////////////////////////////////////////////////////
+// widgets are created on the offscreen platform, results are written
+// as csv and as text to stdout, unless an output is given
+int main(int argc, char* argv[]) {
+	if (!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) {
+		qputenv("QT_QPA_PLATFORM", "offscreen");
+	}
+
+	QApplication app(argc, argv);
+
+	auto arguments = app.arguments();
+	if (!arguments.contains("-o")) {
+		arguments << "-o" << "results.csv,csv" << "-o" << "-,txt";
+	}
+
+	TreeBenchmark benchmark;
+	return QTest::qExec(&benchmark, arguments);
+}
+
+#include "bench.moc"
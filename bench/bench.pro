@@ -0,0 +1,47 @@
+# ----------------------------------------------------
+# Headless benchmarks of the model, proxy and serialization.
+# Results are written to results.csv, unless "-o file,format" is given,
+# CARBRANDS_BENCH_MAX_NODES limits the size of catalogs.
+# ------------------------------------------------------
+
+TEMPLATE = app
+TARGET = bench
+DESTDIR = ../Win32/Release
+QT += core xml widgets gui concurrent testlib
+CONFIG += release console
+DEFINES += Q_COMPILER_INITIALIZER_LISTS WIN64 QT_DLL QT_WIDGETS_LIB QT_XML_LIB QT_CONCURRENT_LIB QT_TESTLIB_LIB
+INCLUDEPATH += ../carbrands \
+    ./GeneratedFiles \
+    ./GeneratedFiles/Release
+DEPENDPATH += ../carbrands
+MOC_DIR += ./GeneratedFiles/release
+OBJECTS_DIR += release
+RCC_DIR += ./GeneratedFiles
+HEADERS += ../carbrands/treeitem.h \
+    ../carbrands/chunkedlist.h \
+    ../carbrands/labeltable.h \
+    ../carbrands/objectpool.h \
+    ../carbrands/treewidget.h \
+    ../carbrands/treemodel.h \
+    ../carbrands/treesnapshot.h \
+    ../carbrands/sortfilterproxymodel.h \
+    ../carbrands/buttonsdelegate.h \
+    ../carbrands/treejournal.h \
+    ../carbrands/trigramindex.h \
+    ../carbrands/textmatcher.h \
+    ../carbrands/fuzzymatcher.h \
+    ../carbrands/instrumentation.h \
+    ../carbrands/logger.h \
+    ../carbrands/snapshotindex.h
+SOURCES += ./bench.cpp \
+    ../carbrands/buttonsdelegate.cpp \
+    ../carbrands/sortfilterproxymodel.cpp \
+    ../carbrands/treemodel.cpp \
+    ../carbrands/treewidget.cpp \
+    ../carbrands/treejournal.cpp \
+    ../carbrands/textmatcher.cpp \
+    ../carbrands/fuzzymatcher.cpp \
+    ../carbrands/instrumentation.cpp \
+    ../carbrands/logger.cpp
+RESOURCES += ../carbrands/mainwidget.qrc
+win32: LIBS += -lpsapi
@@ -0,0 +1,7 @@
+# Application, its benchmarks and tests, e.g.
+#   qmake carbrands.pro && make && Win32/Release/bench && Win32/Release/tests
+
+TEMPLATE = subdirs
+SUBDIRS += carbrands \
+    bench \
+    tests
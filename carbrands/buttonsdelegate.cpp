@@ -5,69 +5,53 @@
 
 enum { WIDTH_MARGIN = 2 };
 
-class ButtonIterate {
-public:
-	ButtonIterate(const QVector<QPixmap>& icons, bool isHideAddChild) :
-		icons_(icons),
-		isHideAddChild_(isHideAddChild),
-		picon_(nullptr),
-		buttonIndex_(icons_.size())
-	{
-	}
+bool isHideAddChild(const QModelIndex& index) {
+	return index.parent().isValid();
+}
 
-	const QPixmap& icon() const { return *picon_; }
+// text is drawn with the same margin as by QItemDelegate
+QRect textRect(const QStyleOptionViewItem& option, const QRect& rect) {
+	auto style = (option.widget) ? option.widget->style() : QApplication::style();
+	auto margin = style->pixelMetric(QStyle::PM_FocusFrameHMargin, 0, option.widget) + 1;
+	return rect.adjusted(margin, 0, -margin, 0);
+}
 
-	bool isHide() const { 
-		return isHideAddChild_ && type() == ButtonsDelegate::ADD_CHILD_ITEM_BUTTON;
-	}
+// one left aligned line, as tree items are, is drawn without the base class
+bool isPlainLine(const QStyleOptionViewItem& option) {
+	return !(option.state & QStyle::State_Editing)
+		&& !(option.features & QStyleOptionViewItem::WrapText)
+		&& option.direction == Qt::LeftToRight
+		&& (option.displayAlignment & Qt::AlignHorizontal_Mask) == Qt::AlignLeft;
+}
 
-	bool next() {
-		return (--buttonIndex_ >= 0) && (picon_ = &icons_[buttonIndex_], true);
+// units of text, which are drawn at their places in the shown, elided text:
+// all, if text is not elided, the common prefix, if its end is elided,
+// and none otherwise
+int visibleLength(const QString& text, const QString& shown, Qt::TextElideMode mode) {
+	if (shown == text) {
+		return text.size();
 	}
-
-	int width() const { return icon().width() + WIDTH_MARGIN; }
-
-	int height() const { return icon().height(); }
-
-	ButtonsDelegate::ButtonsType type() const {
-		return static_cast<ButtonsDelegate::ButtonsType>(buttonIndex_);
+	if (mode != Qt::ElideRight) {
+		return 0;
 	}
 
-private:
-	const QVector<QPixmap>& icons_;
-	const bool isHideAddChild_;
-	const QPixmap* picon_;
-	int buttonIndex_;
-};
-
-bool isHideAddChild(const QModelIndex& index) {
-	return index.parent().isValid();
-}
-
-class ButtonPositionIterate : public ButtonIterate {
-public:
-	ButtonPositionIterate(
-		const QVector<QPixmap>& icons, 
-		const QStyleOptionViewItem &option, 
-		bool isHideAddChild
-	) : ButtonIterate(icons, isHideAddChild), 
-		pos_(option.rect.right(), option.rect.center().y()) {}
-
-	QPoint nextPos() { 
-		return QPoint(
-			pos_.rx() -= width(), 
-			pos_.y() - height()/2
-		);
+	int length = 0;
+	while (length < shown.size() && length < text.size() && shown[length] == text[length]) {
+		++length;
 	}
-
-private:
-	QPoint pos_;
-};
+	return length;
+}
 
 ButtonsDelegate::ButtonsDelegate(const QSize& size, QObject *parent)
 	: QItemDelegate(parent),
 	icons_(BUTTON_TYPE_COUNT),
-	placeholderText_(tr("Enter text"))
+	placeholderText_(tr("Enter text")),
+	matchRange_(),
+	textLayouts_(LAYOUT_CACHE_SIZE),
+	elidedTexts_(LAYOUT_CACHE_SIZE),
+	buttonsLayouts_(),
+	sizeHints_(SIZE_HINT_CACHE_SIZE),
+	cacheFont_()
 {
 	auto buttonInit = [this, &size](
 		ButtonsType type, 
@@ -90,6 +74,11 @@ ButtonsDelegate::ButtonsDelegate(const QSize& size, QObject *parent)
 }
 
 void ButtonsDelegate::paint(QPainter *painter, const QStyleOptionViewItem &option, const QModelIndex &index) const {
+	InstrumentationTimer timer(Instrumentation::DELEGATE_PAINT);
+	auto range = index.data(SortFilterProxyModel::MATCH_RANGE_ROLE);
+	matchRange_ = (range.isValid())
+		? range.value<SortFilterProxyModel::MatchRange>()
+		: SortFilterProxyModel::MatchRange{ 0, 0 };
 	QItemDelegate::paint(painter, option, index);
 	
 	if (index.data(Qt::DisplayRole).toString().isEmpty()) {
@@ -104,32 +93,175 @@ void ButtonsDelegate::paint(QPainter *painter, const QStyleOptionViewItem &optio
 	}
 
 	if (option.state & QStyle::State_MouseOver) {
-		ButtonPositionIterate button(icons_, option, index.parent().isValid());
-		while (button.next()) {
-			if (!button.isHide()) {
-				painter->drawPixmap(button.nextPos(), button.icon());
-			}
-		}
+		auto& layout = buttonsLayout(option.rect.height(), isHideAddChild(index));
+		painter->drawPixmap(option.rect.right() - layout.size.width(), option.rect.top(), layout.overlay);
+	}
+}
+
+// matched text is highlighted over the drawn text, the part of match
+// after the elision point is not highlighted
+void ButtonsDelegate::drawDisplay(
+	QPainter *painter,
+	const QStyleOptionViewItem &option,
+	const QRect &rect,
+	const QString &text
+) const {
+	auto textRect = ::textRect(option, rect);
+	QString shown;
+	if (isPlainLine(option)) {
+		shown = drawElidedText(painter, option, rect, textRect, text);
+	}
+	else {
+		QItemDelegate::drawDisplay(painter, option, rect, text);
+		shown = QFontMetrics(option.font).elidedText(text, option.textElideMode, textRect.width());
+	}
+
+	auto end = qMin(matchRange_.position + matchRange_.length, visibleLength(text, shown, option.textElideMode));
+	if (matchRange_.length <= 0 || matchRange_.position >= end) {
+		return;
+	}
+
+	auto line = textLayout(shown, option.font)->lineAt(0);
+	auto left = textRect.left() + qRound(line.cursorToX(matchRange_.position));
+	auto right = textRect.left() + qRound(line.cursorToX(end));
+	auto highlight = QRect(left, textRect.top(), right - left, textRect.height()) & textRect;
+	painter->fillRect(highlight, QColor(255, 192, 0, 96));
+}
+
+// colors are chosen as by QItemDelegate, the text is elided
+// and laid out once per text and width, returns the elided text
+QString ButtonsDelegate::drawElidedText(
+	QPainter *painter,
+	const QStyleOptionViewItem &option,
+	const QRect &rect,
+	const QRect &textRect,
+	const QString &text
+) const {
+	auto colorGroup = (option.state & QStyle::State_Enabled) ? QPalette::Normal : QPalette::Disabled;
+	if (colorGroup == QPalette::Normal && !(option.state & QStyle::State_Active)) {
+		colorGroup = QPalette::Inactive;
+	}
+
+	if (option.state & QStyle::State_Selected) {
+		painter->fillRect(rect, option.palette.brush(colorGroup, QPalette::Highlight));
+		painter->setPen(option.palette.color(colorGroup, QPalette::HighlightedText));
+	}
+	else {
+		painter->setPen(option.palette.color(colorGroup, QPalette::Text));
+	}
+
+	if (text.isEmpty()) {
+		return text;
+	}
+
+	updateFont(option.font);
+
+	auto elided = elidedTexts_.object(text);
+	if (!elided || elided->width != textRect.width() || elided->mode != option.textElideMode) {
+		elided = new ElidedText{ textRect.width(), option.textElideMode, QStaticText() };
+		elided->text.setTextFormat(Qt::PlainText);
+		elided->text.setText(QFontMetrics(option.font).elidedText(
+			text, option.textElideMode, textRect.width()
+		));
+		elided->text.prepare(QTransform(), option.font);
+		elidedTexts_.insert(text, elided);
+	}
+
+	auto top = textRect.top() + (textRect.height() - qRound(elided->text.size().height())) / 2;
+	auto oldFont = painter->font();
+	painter->setFont(option.font);
+	painter->drawStaticText(textRect.left(), top, elided->text);
+	painter->setFont(oldFont);
+	return elided->text.text();
+}
+
+// layouts are cached by text, while the font is not changed
+QTextLayout* ButtonsDelegate::textLayout(const QString& text, const QFont& font) const {
+	updateFont(font);
+
+	auto layout = textLayouts_.object(text);
+	if (!layout) {
+		layout = new QTextLayout(text, font);
+		QTextOption textOption;
+		textOption.setWrapMode(QTextOption::NoWrap);
+		layout->setTextOption(textOption);
+		layout->beginLayout();
+		layout->createLine().setLineWidth(QWIDGETSIZE_MAX);
+		layout->endLayout();
+		textLayouts_.insert(text, layout);
 	}
+	return layout;
 }
 
-QSize buttonsSize(const QVector<QPixmap>& icons, bool isHideAddChild, QSize size = QSize()) {
-	ButtonIterate button(icons, isHideAddChild);
-	while (button.next()) {
-		if (!button.isHide()) {
-			size.rwidth() += button.width();
-			size.setHeight(qMax(size.height(), button.height()));
+void ButtonsDelegate::updateFont(const QFont& font) const {
+	if (font != cacheFont_) {
+		textLayouts_.clear();
+		elidedTexts_.clear();
+		sizeHints_.clear();
+		cacheFont_ = font;
+	}
+}
+
+// buttons are placed from the right edge of the row to the left,
+// each is centered vertically, the layout is made once per row height
+const ButtonsDelegate::ButtonsLayout& ButtonsDelegate::buttonsLayout(int rowHeight, bool isHideAddChild) const {
+	auto key = (rowHeight << 1) | int(isHideAddChild);
+	auto it = buttonsLayouts_.find(key);
+	if (it != buttonsLayouts_.end()) {
+		return it.value();
+	}
+
+	ButtonsLayout layout;
+	auto center = (rowHeight - 1) / 2;
+	int right = 0;
+	for (int type = BUTTON_TYPE_COUNT - 1; type >= 0; --type) {
+		if (isHideAddChild && type == ADD_CHILD_ITEM_BUTTON) {
+			continue;
 		}
+
+		auto& icon = icons_[type];
+		auto width = icon.width() + WIDTH_MARGIN;
+		right -= width;
+		layout.rects[type] = QRect(right, center - icon.height() / 2, width, icon.height());
+		layout.size.rwidth() += width;
+		layout.size.setHeight(qMax(layout.size.height(), icon.height()));
 	}
-	return size;
+
+	if (rowHeight > 0 && !layout.size.isEmpty()) {
+		auto ratio = icons_.front().devicePixelRatio();
+		layout.overlay = QPixmap(QSize(layout.size.width(), rowHeight) * ratio);
+		layout.overlay.setDevicePixelRatio(ratio);
+		layout.overlay.fill(Qt::transparent);
+
+		QPainter painter(&layout.overlay);
+		for (int type = 0; type < BUTTON_TYPE_COUNT; ++type) {
+			auto& rect = layout.rects[type];
+			if (!rect.isNull()) {
+				painter.drawPixmap(rect.topLeft() + QPoint(layout.size.width(), 0), icons_[type]);
+			}
+		}
+	}
+
+	return buttonsLayouts_.insert(key, layout).value();
 }
 
+// text is measured by the base class once per text
 QSize ButtonsDelegate::sizeHint(const QStyleOptionViewItem &option, const QModelIndex &index) const
 {
-	return buttonsSize(
-		icons_, 
-		isHideAddChild(index), 
-		QItemDelegate::sizeHint(option, index)
+	updateFont(option.font);
+
+	auto text = index.data(Qt::DisplayRole).toString();
+	auto size = sizeHints_.object(text);
+	if (!size) {
+		size = new QSize(QItemDelegate::sizeHint(option, index));
+		sizeHints_.insert(text, size);
+	}
+
+	// width of buttons does not depend on the row, so no overlay is made for it
+	auto& layout = buttonsLayout(0, isHideAddChild(index));
+	return QSize(
+		size->width() + layout.size.width(),
+		qMax(size->height(), layout.size.height())
 	);
 }
 
@@ -155,7 +287,7 @@ void ButtonsDelegate::updateEditorGeometry(
 	if (lineEdit) {
 		auto rect = option.rect;
 		rect.setWidth(option.rect.width()
-			- buttonsSize(icons_, false).width()
+			- buttonsLayout(option.rect.height(), false).size.width()
 		);
 		lineEdit->setGeometry(rect);
 	}
@@ -176,18 +308,15 @@ bool ButtonsDelegate::editorEvent(
 		type == QEvent::MouseMove ) {
 		QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(qevent);
 		
-		ButtonPositionIterate button(icons_, option, isHideAddChild(index));
-		while (button.next()) {
-			if (!button.isHide()) {
-				auto pos = button.nextPos().x();
-				auto endPos = pos + button.width();
-				auto mousePos = mouseEvent->pos().x();
-				if (mousePos >= pos && mousePos < endPos) {
-					if (isRelease) {
-						emit buttonClicked(button.type(), index);
-					}
-					return true;
+		auto& layout = buttonsLayout(option.rect.height(), isHideAddChild(index));
+		auto mousePos = mouseEvent->pos().x() - option.rect.right();
+		for (int type = 0; type < BUTTON_TYPE_COUNT; ++type) {
+			auto& rect = layout.rects[type];
+			if (!rect.isNull() && mousePos >= rect.left() && mousePos <= rect.right()) {
+				if (isRelease) {
+					emit buttonClicked(static_cast<ButtonsType>(type), index);
 				}
+				return true;
 			}
 		}
 	}
@@ -3,6 +3,11 @@
 
 #include <QItemDelegate>
 #include <QVector>
+#include <QCache>
+#include <QTextLayout>
+#include <QStaticText>
+
+#include "sortfilterproxymodel.h"
 
 class ButtonsDelegate : public QItemDelegate
 {
@@ -17,6 +22,24 @@ public:
 		BUTTON_TYPE_COUNT
 	};
 
+	enum { LAYOUT_CACHE_SIZE = 512 };
+	enum { SIZE_HINT_CACHE_SIZE = 4096 };
+
+	// buttons of a row, rects are relative to the top right corner of the row,
+	// hidden buttons have null rects, overlay has all visible buttons
+	struct ButtonsLayout {
+		QRect rects[BUTTON_TYPE_COUNT];
+		QSize size;
+		QPixmap overlay;
+	};
+
+	// text elided to width
+	struct ElidedText {
+		int width;
+		Qt::TextElideMode mode;
+		QStaticText text;
+	};
+
 public:
 	ButtonsDelegate(const QSize& size, QObject *parent = 0);
 
@@ -58,9 +81,40 @@ protected:
 		const QModelIndex &index
 	) Q_DECL_OVERRIDE;
 
+	void drawDisplay(
+		QPainter *painter,
+		const QStyleOptionViewItem &option,
+		const QRect &rect,
+		const QString &text
+	) const Q_DECL_OVERRIDE;
+
+private:
+	QTextLayout* textLayout(const QString& text, const QFont& font) const;
+	QString drawElidedText(
+		QPainter *painter,
+		const QStyleOptionViewItem &option,
+		const QRect &rect,
+		const QRect &textRect,
+		const QString &text
+	) const;
+	const ButtonsLayout& buttonsLayout(int rowHeight, bool isHideAddChild) const;
+	void updateFont(const QFont& font) const;
+
 protected:
 	QVector<QPixmap> icons_;
 	QString placeholderText_;
+
+private:
+	// match range of the painted item, layouts of highlighted texts
+	mutable SortFilterProxyModel::MatchRange matchRange_;
+	mutable QCache<QString, QTextLayout> textLayouts_;
+	mutable QCache<QString, ElidedText> elidedTexts_;
+
+	// layouts of buttons by row height and add child button,
+	// size hints of texts by the base class, while the font is not changed
+	mutable QHash<int, ButtonsLayout> buttonsLayouts_;
+	mutable QCache<QString, QSize> sizeHints_;
+	mutable QFont cacheFont_;
 };
 
 #endif // BUTTONSDELEGATE_H
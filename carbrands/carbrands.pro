@@ -5,9 +5,9 @@
 TEMPLATE = app
 TARGET = carbrands
 DESTDIR = ../Win32/Release
-QT += core xml widgets gui
+QT += core xml widgets gui concurrent
 CONFIG += release
-DEFINES += Q_COMPILER_INITIALIZER_LISTS WIN64 QT_DLL QT_WIDGETS_LIB QT_XML_LIB
+DEFINES += Q_COMPILER_INITIALIZER_LISTS WIN64 QT_DLL QT_WIDGETS_LIB QT_XML_LIB QT_CONCURRENT_LIB
 INCLUDEPATH += ./GeneratedFiles \
     . \
     ./GeneratedFiles/Release
@@ -18,17 +18,33 @@ UI_DIR += ./GeneratedFiles
 RCC_DIR += ./GeneratedFiles
 TRANSLATIONS += ru.ts
 HEADERS += ./treeitem.h \
+    ./chunkedlist.h \
+    ./labeltable.h \
+    ./objectpool.h \
     ./mainwidget.h \
     ./treewidget.h \
     ./treemodel.h \
+    ./treesnapshot.h \
     ./sortfilterproxymodel.h \
-    ./buttonsdelegate.h
+    ./buttonsdelegate.h \
+    ./treejournal.h \
+    ./trigramindex.h \
+    ./textmatcher.h \
+    ./fuzzymatcher.h \
+    ./instrumentation.h \
+    ./logger.h \
+    ./snapshotindex.h
 SOURCES += ./buttonsdelegate.cpp \
     ./main.cpp \
     ./mainwidget.cpp \
     ./sortfilterproxymodel.cpp \
     ./treemodel.cpp \
-    ./treewidget.cpp
+    ./treewidget.cpp \
+    ./treejournal.cpp \
+    ./textmatcher.cpp \
+    ./fuzzymatcher.cpp \
+    ./instrumentation.cpp \
+    ./logger.cpp
 FORMS += ./mainwidget.ui
 TRANSLATIONS += ./ru.ts
 RESOURCES += mainwidget.qrc
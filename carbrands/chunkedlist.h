@@ -0,0 +1,241 @@
+#ifndef CHUNKEDLIST_H
+#define CHUNKEDLIST_H
+
+#include <QtCore>
+#include <algorithm>
+
+// List of item pointers split into chunks of bounded size.
+// Insert and remove shift only one chunk, the row of an item is the offset
+// of its chunk plus its slot in the chunk. Chunk offsets are recomputed
+// lazily, starting from the first chunk that changed.
+//
+// T must have a member "position_" of type ChunkedList<T>::Position
+// and grant friendship to ChunkedList<T>.
+template <typename T>
+class ChunkedList
+{
+public:
+	enum { CHUNK_SIZE = 256 };
+
+	struct Chunk {
+		const ChunkedList* list;
+		int index;
+		int offset;
+		QVector<T*> items;
+	};
+
+	struct Position {
+		Position() : chunk(nullptr), slot(0) {}
+
+		Chunk* chunk;
+		int slot;
+	};
+
+public:
+	ChunkedList() : chunks_(), size_(0), validOffsets_(0) {}
+
+	~ChunkedList() {
+		qDeleteAll(chunks_);
+	}
+
+	int size() const {
+		return size_;
+	}
+
+	bool isEmpty() const {
+		return size_ == 0;
+	}
+
+	T* value(int row, T* defaultValue = nullptr) const {
+		if (row < 0 || row >= size_) {
+			return defaultValue;
+		}
+
+		auto chunk = find(row);
+		return chunk->items[row - chunk->offset];
+	}
+
+	static int row(const Position& position) {
+		auto chunk = position.chunk;
+		return (chunk)
+			? chunk->list->offset(chunk->index) + position.slot
+			: 0;
+	}
+
+	void insert(int row, T* item) {
+		if (chunks_.isEmpty()) {
+			insertChunk(0);
+		}
+
+		auto chunk = (row >= size_) ? chunks_.last() : find(row);
+		auto slot = qMin(row - offset(chunk->index), chunk->items.size());
+		chunk->items.insert(slot, item);
+		++size_;
+
+		updatePositions(chunk, slot);
+		invalidate(chunk->index + 1);
+
+		if (chunk->items.size() > 2 * CHUNK_SIZE) {
+			split(chunk, chunk->items.size() / 2);
+		}
+	}
+
+	// insert items at row, the items get chunks of their own
+	void insert(int row, const QVector<T*>& items) {
+		if (items.isEmpty()) {
+			return;
+		}
+
+		auto index = chunks_.size();
+		if (row < size_) {
+			auto chunk = find(row);
+			auto slot = row - chunk->offset;
+			index = chunk->index;
+			if (slot > 0) {
+				split(chunk, slot);
+				++index;
+			}
+		}
+
+		QList<Chunk*> chunks;
+		for (int i = 0; i < items.size(); i += CHUNK_SIZE) {
+			auto chunk = new Chunk{ this, 0, 0, items.mid(i, CHUNK_SIZE) };
+			updatePositions(chunk, 0);
+			chunks.push_back(chunk);
+		}
+
+		chunks_ = chunks_.mid(0, index) + chunks + chunks_.mid(index);
+		size_ += items.size();
+		updateIndexes(index);
+	}
+
+	QVector<T*> takeAll() {
+		QVector<T*> items;
+		items.reserve(size_);
+		forEach([&items](T* item) {
+			item->position_ = Position();
+			items.push_back(item);
+		});
+
+		qDeleteAll(chunks_);
+		chunks_.clear();
+		size_ = 0;
+		validOffsets_ = 0;
+
+		return items;
+	}
+
+	T* take(int row) {
+		auto chunk = find(row);
+		auto slot = row - chunk->offset;
+		auto item = chunk->items.takeAt(slot);
+		item->position_ = Position();
+		--size_;
+
+		updatePositions(chunk, slot);
+		invalidate(chunk->index + 1);
+
+		auto index = chunk->index;
+		if (chunk->items.isEmpty()) {
+			removeChunk(index);
+		}
+		else if (index + 1 < chunks_.size()
+			&& chunk->items.size() + chunks_[index + 1]->items.size() <= CHUNK_SIZE) {
+			merge(chunk);
+		}
+
+		return item;
+	}
+
+	template <typename F>
+	void forEach(F f) const {
+		for (auto chunk : chunks_) {
+			for (auto item : chunk->items) {
+				f(item);
+			}
+		}
+	}
+
+private:
+	Q_DISABLE_COPY(ChunkedList)
+
+	Chunk* find(int row) const {
+		validate(chunks_.size());
+		auto it = std::upper_bound(chunks_.begin(), chunks_.end(), row,
+			[](int row, const Chunk* chunk) { return row < chunk->offset; }
+		);
+		return *(it - 1);
+	}
+
+	int offset(int index) const {
+		validate(index + 1);
+		return chunks_[index]->offset;
+	}
+
+	void validate(int count) const {
+		for (; validOffsets_ < count; ++validOffsets_) {
+			auto chunk = chunks_[validOffsets_];
+			if (validOffsets_ == 0) {
+				chunk->offset = 0;
+			}
+			else {
+				auto prev = chunks_[validOffsets_ - 1];
+				chunk->offset = prev->offset + prev->items.size();
+			}
+		}
+	}
+
+	void invalidate(int index) {
+		validOffsets_ = qMin(validOffsets_, index);
+	}
+
+	void updatePositions(Chunk* chunk, int slot) {
+		for (int i = slot; i < chunk->items.size(); ++i) {
+			auto& position = chunk->items[i]->position_;
+			position.chunk = chunk;
+			position.slot = i;
+		}
+	}
+
+	void updateIndexes(int index) {
+		for (int i = index; i < chunks_.size(); ++i) {
+			chunks_[i]->index = i;
+		}
+		invalidate(index);
+	}
+
+	void insertChunk(int index) {
+		chunks_.insert(index, new Chunk{ this, index, 0, {} });
+		updateIndexes(index);
+	}
+
+	void removeChunk(int index) {
+		delete chunks_.takeAt(index);
+		updateIndexes(index);
+	}
+
+	void split(Chunk* chunk, int slot) {
+		insertChunk(chunk->index + 1);
+
+		auto next = chunks_[chunk->index + 1];
+		next->items = chunk->items.mid(slot);
+		chunk->items.resize(slot);
+		updatePositions(next, 0);
+	}
+
+	void merge(Chunk* chunk) {
+		auto next = chunks_[chunk->index + 1];
+		auto slot = chunk->items.size();
+		chunk->items += next->items;
+		next->items.clear();
+		updatePositions(chunk, slot);
+		removeChunk(next->index);
+	}
+
+private:
+	QList<Chunk*> chunks_;
+	int size_;
+	mutable int validOffsets_;
+};
+
+#endif // CHUNKEDLIST_H
@@ -0,0 +1,230 @@
+#include "fuzzymatcher.h"
+#include <QtConcurrent>
+#include <algorithm>
+
+// simple case folding of one unit, surrogates are left as they are
+inline ushort foldUnit(ushort unit) {
+	if (unit < 0x80) {
+		return (unit >= 'A' && unit <= 'Z') ? unit + ('a' - 'A') : unit;
+	}
+	return ushort(QChar::toCaseFolded(uint(unit)));
+}
+
+FuzzyMatcher::FuzzyMatcher(const QString& text)
+	: text_(text),
+	folded_(),
+	masks_(),
+	maxDistance_(0)
+{
+	std::fill(asciiMasks_, asciiMasks_ + ASCII_SIZE, quint64(0));
+
+	auto data = reinterpret_cast<const ushort*>(text.constData());
+	auto length = qMin(text.size(), int(MAX_LENGTH));
+	for (int i = 0; i < length; ++i) {
+		auto unit = foldUnit(data[i]);
+		folded_.push_back(unit);
+
+		// bit i is set in the mask of the unit at position i of text
+		auto bit = quint64(1) << i;
+		if (unit < ASCII_SIZE) {
+			asciiMasks_[unit] |= bit;
+			continue;
+		}
+
+		auto it = std::find_if(masks_.begin(), masks_.end(),
+			[unit](const QPair<ushort, quint64>& mask) { return mask.first == unit; });
+		if (it != masks_.end()) {
+			it->second |= bit;
+		}
+		else {
+			masks_.push_back(qMakePair(unit, bit));
+		}
+	}
+
+	maxDistance_ = (folded_.size() + 1) / 4;
+}
+
+quint64 FuzzyMatcher::mask(ushort unit) const {
+	if (unit < ASCII_SIZE) {
+		return asciiMasks_[unit];
+	}
+
+	for (auto& mask : masks_) {
+		if (mask.first == unit) {
+			return mask.second;
+		}
+	}
+	return 0;
+}
+
+int FuzzyMatcher::score(const QChar* data, int size) const {
+	auto distance = this->distance(data, size);
+	if (distance <= maxDistance_) {
+		return 2 * distance;
+	}
+
+	return (isSubsequence(data, size))
+		? 2 * maxDistance_ + 1
+		: int(NO_MATCH);
+}
+
+// vertical deltas of the last column of the edit distance matrix are kept
+// in pv (+1) and mv (-1), the first row is zero, as a match may start anywhere
+int FuzzyMatcher::distance(const QChar* chars, int size) const {
+	auto length = folded_.size();
+	if (length == 0) {
+		return 0;
+	}
+
+	auto data = reinterpret_cast<const ushort*>(chars);
+	auto last = quint64(1) << (length - 1);
+	auto pv = ~quint64(0);
+	quint64 mv = 0;
+	auto distance = length;
+	auto best = length;
+	for (int i = 0; i < size && best > 0; ++i) {
+		auto eq = mask(foldUnit(data[i]));
+		auto xv = eq | mv;
+		auto xh = (((eq & pv) + pv) ^ pv) | eq;
+		auto ph = mv | ~(xh | pv);
+		auto mh = pv & xh;
+
+		if (ph & last) {
+			++distance;
+		}
+		else if (mh & last) {
+			--distance;
+		}
+
+		ph <<= 1;
+		mh <<= 1;
+		pv = mh | ~(xv | ph);
+		mv = ph & xv;
+		best = qMin(best, distance);
+	}
+	return best;
+}
+
+bool FuzzyMatcher::isSubsequence(const QChar* chars, int size) const {
+	auto data = reinterpret_cast<const ushort*>(chars);
+	int matched = 0;
+	for (int i = 0; i < size && matched < folded_.size(); ++i) {
+		if (foldUnit(data[i]) == folded_[matched]) {
+			++matched;
+		}
+	}
+	return matched == folded_.size();
+}
+
+// ranking
+///////////////////////////////////////////////////////////////////////////////
+bool FuzzyRanking::isBetter(const Match& left, const Match& right) {
+	if (left.score != right.score) {
+		return left.score < right.score;
+	}
+	if (left.text.size() != right.text.size()) {
+		return left.text.size() < right.text.size();
+	}
+	return left.text < right.text;
+}
+
+void FuzzyRanking::insert(const QString& text, int score, int count) {
+	if (limit_ <= 0 || count <= 0) {
+		return;
+	}
+
+	Match match = { text, score, count };
+	if (itemCount_ >= limit_ && !isBetter(match, heap_.front())) {
+		return;
+	}
+
+	// the heap has at most limit matches, so it is searched for the text
+	auto it = std::find_if(heap_.begin(), heap_.end(),
+		[&text](const Match& current) { return current.text == text; });
+	if (it != heap_.end()) {
+		if (it->count < count) {
+			itemCount_ += count - it->count;
+			it->count = count;
+		}
+	}
+	else {
+		heap_.push_back(match);
+		std::push_heap(heap_.begin(), heap_.end(), isBetter);
+		itemCount_ += count;
+	}
+
+	while (!heap_.isEmpty() && itemCount_ - heap_.front().count >= limit_) {
+		itemCount_ -= heap_.front().count;
+		std::pop_heap(heap_.begin(), heap_.end(), isBetter);
+		heap_.pop_back();
+	}
+}
+
+void FuzzyRanking::merge(const FuzzyRanking& ranking) {
+	limit_ = qMax(limit_, ranking.limit_);
+	for (auto& match : ranking.heap_) {
+		insert(match.text, match.score, match.count);
+	}
+}
+
+QVector<FuzzyRanking::Match> FuzzyRanking::matches() const {
+	auto matches = heap_;
+	std::sort_heap(matches.begin(), matches.end(), isBetter);
+	return matches;
+}
+
+// part of labels, which is ranked by one task
+struct LabelRange {
+	QVector<Label> labels;
+	int begin;
+	int end;
+};
+
+// the best labels of range by fuzzy match with text
+struct LabelRanker {
+	typedef FuzzyRanking result_type;
+
+	LabelRanker(const QString& text, int limit) : matcher(text), limit(limit) {}
+
+	FuzzyRanking operator()(const LabelRange& range) const {
+		FuzzyRanking ranking(limit);
+		for (int i = range.begin; i < range.end; ++i) {
+			auto& label = range.labels[i];
+			auto score = matcher.score(label.text);
+			if (score != FuzzyMatcher::NO_MATCH) {
+				ranking.insert(label.text, score, label.refs);
+			}
+		}
+		return ranking;
+	}
+
+	FuzzyMatcher matcher;
+	int limit;
+};
+
+void mergeRanking(FuzzyRanking& result, const FuzzyRanking& ranking) {
+	result.merge(ranking);
+}
+
+// a few ranges per thread, so the ranking is balanced and may be cancelled between them
+QVector<LabelRange> labelRanges(const QVector<Label>& labels) {
+	enum { MIN_RANGE_SIZE = 4096 };
+	enum { RANGES_PER_THREAD = 4 };
+
+	auto count = qMax(1, QThread::idealThreadCount() * RANGES_PER_THREAD);
+	auto size = qMax(int(MIN_RANGE_SIZE), (labels.size() + count - 1) / count);
+
+	QVector<LabelRange> ranges;
+	for (int begin = 0; begin < labels.size(); begin += size) {
+		ranges.push_back({ labels, begin, qMin(begin + size, labels.size()) });
+	}
+	return ranges;
+}
+
+QFuture<FuzzyRanking> rankLabels(const QString& text, const QVector<QVector<Label>>& labelLists, int limit) {
+	QVector<LabelRange> ranges;
+	for (auto& labels : labelLists) {
+		ranges += labelRanges(labels);
+	}
+	return QtConcurrent::mappedReduced(ranges, LabelRanker(text, limit), mergeRanking);
+}
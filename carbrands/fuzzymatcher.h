@@ -0,0 +1,110 @@
+#ifndef FUZZYMATCHER_H
+#define FUZZYMATCHER_H
+
+#include <QtCore>
+
+#include "labeltable.h"
+
+// Approximate search of text in UTF-16 data.
+// The edit distance between text and the closest substring of data is found
+// by the bit-parallel algorithm of Myers, one step per unit of data.
+// Data, which contains text as a subsequence, matches too, but ranks below
+// the data within the distance. Units are compared case folded,
+// text is cut to MAX_LENGTH units.
+class FuzzyMatcher
+{
+public:
+	enum { MAX_LENGTH = 64 };
+	enum { NO_MATCH = -1 };
+
+public:
+	explicit FuzzyMatcher(const QString& text = QString());
+
+	const QString& text() const {
+		return text_;
+	}
+
+	// the greatest distance of a match, about one error per four units
+	int maxDistance() const {
+		return maxDistance_;
+	}
+
+	// score of data, lower is better, or NO_MATCH
+	int score(const QChar* data, int size) const;
+
+	int score(const QString& data) const {
+		return score(data.constData(), data.size());
+	}
+
+	// edit distance between text and the closest substring of data
+	int distance(const QChar* data, int size) const;
+
+	bool isSubsequence(const QChar* data, int size) const;
+
+private:
+	quint64 mask(ushort unit) const;
+
+private:
+	enum { ASCII_SIZE = 128 };
+
+	QString text_;
+	QVector<ushort> folded_;
+	quint64 asciiMasks_[ASCII_SIZE];
+	QVector<QPair<ushort, quint64>> masks_;
+	int maxDistance_;
+};
+
+// The best matches of a fuzzy search.
+// A match is a text with the number of its items, the limit is the number
+// of items: the best matches are kept in a heap with the worst of them on
+// top, while the others have less than limit items without it.
+// Rankings of parts of data are merged into one.
+class FuzzyRanking
+{
+public:
+	struct Match {
+		QString text;
+		int score;
+		int count;
+	};
+
+public:
+	explicit FuzzyRanking(int limit = 0) : limit_(limit), itemCount_(0), heap_() {}
+
+	int limit() const {
+		return limit_;
+	}
+
+	int size() const {
+		return heap_.size();
+	}
+
+	// items of the kept matches
+	int itemCount() const {
+		return itemCount_;
+	}
+
+	// the same text inserted again, e.g. of loaded items and of snapshot,
+	// is one match with the larger count
+	void insert(const QString& text, int score, int count = 1);
+
+	void merge(const FuzzyRanking& ranking);
+
+	// matches from the best one
+	QVector<Match> matches() const;
+
+private:
+	// lower score first, then shorter text, as it is closer to the query
+	static bool isBetter(const Match& left, const Match& right);
+
+private:
+	int limit_;
+	int itemCount_;
+	QVector<Match> heap_;
+};
+
+// labels of the lists are ranked by text in parallel, the count of a match
+// is the number of items with its label
+QFuture<FuzzyRanking> rankLabels(const QString& text, const QVector<QVector<Label>>& labelLists, int limit);
+
+#endif // FUZZYMATCHER_H
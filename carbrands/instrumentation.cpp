@@ -0,0 +1,114 @@
+#include "instrumentation.h"
+
+QAtomicInt Instrumentation::enabled_(0);
+QAtomicInteger<quint64> Instrumentation::counters_[METRIC_COUNT];
+QAtomicInteger<quint64> Instrumentation::totals_[METRIC_COUNT];
+QAtomicInteger<quint64> Instrumentation::buckets_[METRIC_COUNT][BUCKET_COUNT];
+
+void Instrumentation::setEnabled(bool isEnabled) {
+	enabled_.store(isEnabled ? 1 : 0);
+}
+
+void Instrumentation::record(Metric metric, qint64 nsecs) {
+	if (!isEnabled()) {
+		return;
+	}
+
+	auto value = quint64(qMax(nsecs, qint64(0)));
+	int bucket = 0;
+	for (auto rest = value >> 1; rest != 0 && bucket < BUCKET_COUNT - 1; rest >>= 1) {
+		++bucket;
+	}
+
+	counters_[metric].fetchAndAddRelaxed(1);
+	totals_[metric].fetchAndAddRelaxed(value);
+	buckets_[metric][bucket].fetchAndAddRelaxed(1);
+}
+
+const char* Instrumentation::name(Metric metric) {
+	static const char* names[METRIC_COUNT] = {
+		"model.insert",
+		"model.remove",
+		"model.setData",
+		"filter.acceptsRow",
+		"filter.build",
+		"cache.hit",
+		"cache.miss",
+		"cache.clear",
+		"serialize",
+		"deserialize.parse",
+		"deserialize.insert",
+		"snapshot.write",
+		"snapshot.read",
+		"delegate.paint"
+	};
+	return (metric >= 0 && metric < METRIC_COUNT) ? names[metric] : "";
+}
+
+quint64 Instrumentation::counter(Metric metric) {
+	return counters_[metric].load();
+}
+
+quint64 Instrumentation::total(Metric metric) {
+	return totals_[metric].load();
+}
+
+QVector<quint64> Instrumentation::histogram(Metric metric) {
+	QVector<quint64> buckets(BUCKET_COUNT);
+	for (int i = 0; i < BUCKET_COUNT; ++i) {
+		buckets[i] = buckets_[metric][i].load();
+	}
+	return buckets;
+}
+
+void Instrumentation::reset() {
+	for (int metric = 0; metric < METRIC_COUNT; ++metric) {
+		counters_[metric].store(0);
+		totals_[metric].store(0);
+		for (int i = 0; i < BUCKET_COUNT; ++i) {
+			buckets_[metric][i].store(0);
+		}
+	}
+}
+
+// metrics without events are skipped, trailing empty buckets are cut
+QByteArray Instrumentation::report() {
+	QJsonObject metrics;
+	for (int i = 0; i < METRIC_COUNT; ++i) {
+		auto metric = static_cast<Metric>(i);
+		auto count = counter(metric);
+		if (count == 0) {
+			continue;
+		}
+
+		auto buckets = histogram(metric);
+		while (!buckets.isEmpty() && buckets.last() == 0) {
+			buckets.removeLast();
+		}
+
+		QJsonArray histogram;
+		for (auto bucket : buckets) {
+			histogram.append(double(bucket));
+		}
+
+		QJsonObject object;
+		object.insert("count", double(count));
+		object.insert("totalNs", double(total(metric)));
+		object.insert("histogram", histogram);
+		metrics.insert(name(metric), object);
+	}
+
+	QJsonObject report;
+	report.insert("time", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+	report.insert("metrics", metrics);
+	return QJsonDocument(report).toJson();
+}
+
+bool Instrumentation::dump(const QString& fileName) {
+	QSaveFile file(fileName);
+	if (!file.open(QFile::WriteOnly) || file.write(report()) < 0 || !file.commit()) {
+		qWarning() << "can not write instrumentation report " << fileName;
+		return false;
+	}
+	return true;
+}
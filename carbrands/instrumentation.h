@@ -0,0 +1,102 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <QtCore>
+
+// Opt-in counters and latency histograms of the model stack.
+// Each metric counts its events, timed events also add their latency to
+// a histogram with buckets of powers of two nanoseconds.
+// Disabled by default, then a probe only loads one atomic flag.
+class Instrumentation
+{
+public:
+	enum Metric {
+		MODEL_INSERT,
+		MODEL_REMOVE,
+		MODEL_SET_DATA,
+		FILTER_ACCEPTS_ROW,
+		FILTER_BUILD,
+		CACHE_HIT,
+		CACHE_MISS,
+		CACHE_CLEAR,
+		SERIALIZE,
+		DESERIALIZE_PARSE,
+		DESERIALIZE_INSERT,
+		SNAPSHOT_WRITE,
+		SNAPSHOT_READ,
+		DELEGATE_PAINT,
+		METRIC_COUNT
+	};
+
+	// bucket i has latencies from 2^i to 2^(i+1) nanoseconds, the last one has the rest
+	enum { BUCKET_COUNT = 40 };
+
+public:
+	static bool isEnabled() {
+		return enabled_.load() != 0;
+	}
+
+	static void setEnabled(bool isEnabled);
+
+	static void count(Metric metric) {
+		if (isEnabled()) {
+			counters_[metric].fetchAndAddRelaxed(1);
+		}
+	}
+
+	static void record(Metric metric, qint64 nsecs);
+
+	static const char* name(Metric metric);
+
+	static quint64 counter(Metric metric);
+
+	// sum of recorded latencies in nanoseconds
+	static quint64 total(Metric metric);
+
+	static QVector<quint64> histogram(Metric metric);
+
+	static void reset();
+
+	// all metrics as JSON
+	static QByteArray report();
+
+	static bool dump(const QString& fileName);
+
+private:
+	static QAtomicInt enabled_;
+	static QAtomicInteger<quint64> counters_[METRIC_COUNT];
+	static QAtomicInteger<quint64> totals_[METRIC_COUNT];
+	static QAtomicInteger<quint64> buckets_[METRIC_COUNT][BUCKET_COUNT];
+};
+
+// latency of scope, it is measured only if instrumentation is enabled
+class InstrumentationTimer
+{
+public:
+	explicit InstrumentationTimer(Instrumentation::Metric metric) : metric_(metric), timer_() {
+		timer_.invalidate();
+		if (Instrumentation::isEnabled()) {
+			timer_.start();
+		}
+	}
+
+	~InstrumentationTimer() {
+		stop();
+	}
+
+	// latency is recorded before the end of scope, e.g. at the end of a phase
+	void stop() {
+		if (timer_.isValid()) {
+			Instrumentation::record(metric_, timer_.nsecsElapsed());
+			timer_.invalidate();
+		}
+	}
+
+private:
+	Q_DISABLE_COPY(InstrumentationTimer)
+
+	Instrumentation::Metric metric_;
+	QElapsedTimer timer_;
+};
+
+#endif // INSTRUMENTATION_H
@@ -0,0 +1,88 @@
+#ifndef LABELTABLE_H
+#define LABELTABLE_H
+
+#include <QtCore>
+
+#include "objectpool.h"
+
+// interned item data, shared by all items with the same text
+struct Label {
+	QString text;
+	mutable int refs;
+};
+
+// Table of interned labels.
+// Each distinct text is stored once and hashed once, by the table itself,
+// items compare and hash the label pointers instead of the strings.
+// Collation keys of labels are made on first use and kept, until
+// the label is released or the collator is changed.
+class LabelTable
+{
+public:
+	LabelTable() : labels_(), pool_(), collator_(), sortKeys_() {}
+
+	// label for text or nullptr, if no item has this text
+	const Label* find(const QString& text) const {
+		return labels_.value(text, nullptr);
+	}
+
+	const Label* acquire(const QString& text) {
+		auto it = labels_.find(text);
+		if (it == labels_.end()) {
+			auto label = pool_.create();
+			label->text = text;
+			label->refs = 0;
+			it = labels_.insert(label->text, label);
+		}
+
+		auto label = it.value();
+		++label->refs;
+		return label;
+	}
+
+	const Label* acquire(const Label* label) {
+		++label->refs;
+		return label;
+	}
+
+	void release(const Label* label) {
+		if (--label->refs > 0) {
+			return;
+		}
+
+		auto it = labels_.find(label->text);
+		if (it != labels_.end()) {
+			auto removed = it.value();
+			labels_.erase(it);
+			sortKeys_.remove(removed);
+			pool_.destroy(removed);
+		}
+	}
+
+	int size() const {
+		return labels_.size();
+	}
+
+	QCollatorSortKey sortKey(const Label* label) const {
+		auto it = sortKeys_.find(label);
+		if (it == sortKeys_.end()) {
+			it = sortKeys_.insert(label, collator_.sortKey(label->text));
+		}
+		return it.value();
+	}
+
+	void setCollator(const QCollator& collator) {
+		collator_ = collator;
+		sortKeys_.clear();
+	}
+
+private:
+	Q_DISABLE_COPY(LabelTable)
+
+	QHash<QString, Label*> labels_;
+	ObjectPool<Label> pool_;
+	QCollator collator_;
+	mutable QHash<const Label*, QCollatorSortKey> sortKeys_;
+};
+
+#endif // LABELTABLE_H
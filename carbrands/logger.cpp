@@ -0,0 +1,244 @@
+#include "logger.h"
+#include <csignal>
+#include <cstdio>
+
+QAtomicPointer<Logger> Logger::instance_(nullptr);
+
+static const int crashSignals[] = { SIGSEGV, SIGILL, SIGFPE, SIGABRT };
+
+QString backupName(const QString& fileName, int number) {
+	return fileName + '.' + QString::number(number);
+}
+
+QString functionName(QString func) {
+	func = func.left(func.indexOf('(')).trimmed();
+	return func.mid(func.lastIndexOf(' ')).trimmed();
+}
+
+class Logger::Writer : public QThread
+{
+public:
+	explicit Writer(Logger* logger) : logger_(logger) {
+		setObjectName("logger");
+	}
+
+protected:
+	void run() Q_DECL_OVERRIDE {
+		logger_->run();
+	}
+
+private:
+	Logger* logger_;
+};
+
+Logger::Logger(const QString& fileName, qint64 maxSize, int backupCount)
+	: fileName_(fileName),
+	maxSize_(maxSize),
+	backupCount_(backupCount),
+	file_(),
+	slots_(new Slot[CAPACITY]),
+	pushPosition_(0),
+	popPosition_(0),
+	writtenPosition_(0),
+	dropped_(0),
+	wakeup_(),
+	isWaiting_(0),
+	isStopping_(0),
+	writer_(new Writer(this))
+{
+	// slot i is free for the push at position i
+	for (int i = 0; i < CAPACITY; ++i) {
+		slots_[i].sequence.store(i);
+	}
+
+	writer_->start();
+	instance_.storeRelease(this);
+
+	for (auto signal : crashSignals) {
+		std::signal(signal, crashHandler);
+	}
+}
+
+// threads must stop logging before, other lines go to the next logger or stdout
+Logger::~Logger() {
+	for (auto signal : crashSignals) {
+		std::signal(signal, SIG_DFL);
+	}
+	instance_.testAndSetOrdered(this, nullptr);
+
+	isStopping_.storeRelease(1);
+	wake();
+	writer_->wait();
+}
+
+// a slot is claimed by the position, filled and published by its sequence
+bool Logger::write(const Record& record) {
+	auto position = pushPosition_.loadAcquire();
+	for (;;) {
+		auto& slot = slots_[position & (CAPACITY - 1)];
+		auto difference = qint64(slot.sequence.loadAcquire() - position);
+		if (difference == 0) {
+			if (pushPosition_.testAndSetOrdered(position, position + 1)) {
+				slot.record = record;
+				slot.sequence.storeRelease(position + 1);
+				break;
+			}
+		}
+		else if (difference < 0) {
+			dropped_.fetchAndAddRelaxed(1);
+			wake();
+			return false;
+		}
+		position = pushPosition_.loadAcquire();
+	}
+
+	wake();
+	return true;
+}
+
+bool Logger::flush(int msecs) {
+	auto position = pushPosition_.loadAcquire();
+	wake();
+	return waitWritten(position, msecs);
+}
+
+// a missed wake up only delays writing up to FLUSH_INTERVAL
+void Logger::wake() {
+	if (isWaiting_.loadAcquire() != 0 && isWaiting_.testAndSetOrdered(1, 0)) {
+		wakeup_.release();
+	}
+}
+
+bool Logger::waitWritten(quint64 position, int msecs) const {
+	QElapsedTimer timer;
+	timer.start();
+	while (writtenPosition_.loadAcquire() < position) {
+		if (timer.elapsed() >= msecs) {
+			return false;
+		}
+		QThread::msleep(1);
+	}
+	return true;
+}
+
+bool Logger::pop(QByteArray& batch) {
+	auto& slot = slots_[popPosition_ & (CAPACITY - 1)];
+	if (slot.sequence.loadAcquire() != popPosition_ + 1) {
+		return false;
+	}
+
+	batch += format(slot.record);
+	slot.record = Record();
+	slot.sequence.storeRelease(popPosition_ + CAPACITY);
+	++popPosition_;
+	return true;
+}
+
+// the stop flag is read before the ring, so lines pushed before stop are written
+void Logger::run() {
+	rotate();
+
+	for (;;) {
+		auto isStopping = isStopping_.loadAcquire() != 0;
+
+		QByteArray batch;
+		while (batch.size() < BATCH_SIZE && pop(batch)) {
+		}
+
+		auto dropped = dropped_.fetchAndStoreRelaxed(0);
+		if (dropped > 0) {
+			batch += QByteArray::number(dropped) + " log lines are dropped\n";
+		}
+
+		if (!batch.isEmpty()) {
+			writeBatch(batch);
+			continue;
+		}
+		if (isStopping) {
+			break;
+		}
+
+		isWaiting_.fetchAndStoreOrdered(1);
+		auto& slot = slots_[popPosition_ & (CAPACITY - 1)];
+		if (slot.sequence.loadAcquire() != popPosition_ + 1 && isStopping_.loadAcquire() == 0) {
+			wakeup_.tryAcquire(1, FLUSH_INTERVAL);
+		}
+		isWaiting_.fetchAndStoreOrdered(0);
+	}
+
+	file_.close();
+}
+
+void Logger::writeBatch(const QByteArray& batch) {
+	fwrite(batch.constData(), batch.size(), 1, stdout);
+	fflush(stdout);
+
+	if (maxSize_ > 0 && file_.isOpen() && file_.size() > 0 && file_.size() + batch.size() > maxSize_) {
+		rotate();
+	}
+	if (file_.isOpen()) {
+		file_.write(batch);
+		file_.flush();
+	}
+
+	writtenPosition_.storeRelease(popPosition_);
+}
+
+QByteArray Logger::format(const Record& record) {
+	static const QMap<QtMsgType, QString> typeToString {
+		{ QtMsgType::QtDebugMsg, "debug" },
+		{ QtMsgType::QtWarningMsg, "warning" },
+		{ QtMsgType::QtCriticalMsg, "critical" },
+		{ QtMsgType::QtFatalMsg, "fatal" }
+	};
+
+	QString buffer;
+	QTextStream stream(&buffer);
+
+	stream << QDateTime::fromMSecsSinceEpoch(record.msecs).toString("dd.MM.yyyy hh:mm:ss")
+		<< ' ' << typeToString.value(record.type)
+		<< ": " << functionName(record.function)
+		<< ' ' << record.message << '\n';
+	stream.flush();
+
+	return buffer.toLocal8Bit();
+}
+
+// errors of the writer go to stderr, as its own messages would come back to the ring
+bool Logger::open() {
+	file_.setFileName(fileName_);
+	if (!file_.open(QFile::WriteOnly | QFile::Append)) {
+		fprintf(stderr, "can not open log file %s\n", qPrintable(fileName_));
+		return false;
+	}
+	return true;
+}
+
+// log is moved to backup 1, backup i to i + 1, the last backup is removed
+void Logger::rotate() {
+	file_.close();
+
+	if (backupCount_ <= 0) {
+		QFile::remove(fileName_);
+	}
+	else {
+		QFile::remove(backupName(fileName_, backupCount_));
+		for (int i = backupCount_ - 1; i > 0; --i) {
+			QFile::rename(backupName(fileName_, i), backupName(fileName_, i + 1));
+		}
+		QFile::rename(fileName_, backupName(fileName_, 1));
+	}
+
+	open();
+}
+
+// the writer keeps working while another thread crashes, so it is waited for
+void Logger::crashHandler(int signal) {
+	auto logger = instance();
+	if (logger) {
+		logger->waitWritten(logger->pushPosition_.loadAcquire(), FLUSH_TIMEOUT);
+	}
+
+	std::signal(signal, SIG_DFL);
+	std::raise(signal);
+}
@@ -0,0 +1,97 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <QtCore>
+
+// Asynchronous log file.
+// Records are pushed by any thread into a bounded lock-free ring, formatted
+// and written in batches to stdout and the log file by a writer thread,
+// which keeps the file open. The file is rotated by size to numbered backups,
+// lines are dropped and counted while the ring is full.
+// The ring is flushed on destruction and on crash signals.
+class Logger
+{
+public:
+	enum { CAPACITY = 8192 }; // power of two
+	enum { MAX_SIZE = 4 * 1024 * 1024 };
+	enum { BACKUP_COUNT = 3 };
+
+	// message as it is logged, function is a static string, e.g. of
+	// QMessageLogContext, or null
+	struct Record {
+		qint64 msecs;
+		QtMsgType type;
+		const char* function;
+		QString message;
+	};
+
+public:
+	explicit Logger(const QString& fileName, qint64 maxSize = MAX_SIZE, int backupCount = BACKUP_COUNT);
+	~Logger();
+
+	// logger, which is alive, or null
+	static Logger* instance() {
+		return instance_.loadAcquire();
+	}
+
+	// false if ring is full and record is dropped
+	bool write(const Record& record);
+
+	// log line: <timestamp> <type>: <function> <message>
+	static QByteArray format(const Record& record);
+
+	// wait until pushed lines are written, e.g. before a fatal exit
+	bool flush(int msecs = FLUSH_TIMEOUT);
+
+private:
+	class Writer;
+
+	struct Slot {
+		QAtomicInteger<quint64> sequence;
+		Record record;
+	};
+
+	enum { FLUSH_INTERVAL = 100 };
+	enum { FLUSH_TIMEOUT = 1000 };
+	enum { BATCH_SIZE = 64 * 1024 };
+
+	Q_DISABLE_COPY(Logger)
+
+	void run();
+
+	void wake();
+
+	// only atomics and sleep, so it is called from signal handler
+	bool waitWritten(quint64 position, int msecs) const;
+
+	bool pop(QByteArray& batch);
+
+	void writeBatch(const QByteArray& batch);
+
+	bool open();
+
+	void rotate();
+
+	static void crashHandler(int signal);
+
+private:
+	static QAtomicPointer<Logger> instance_;
+
+	QString fileName_;
+	qint64 maxSize_;
+	int backupCount_;
+	QFile file_;
+
+	QScopedArrayPointer<Slot> slots_;
+	QAtomicInteger<quint64> pushPosition_;
+	quint64 popPosition_;
+	QAtomicInteger<quint64> writtenPosition_;
+	QAtomicInt dropped_;
+
+	QSemaphore wakeup_;
+	QAtomicInt isWaiting_;
+	QAtomicInt isStopping_;
+	QScopedPointer<Writer> writer_;
+};
+
+#endif // LOGGER_H
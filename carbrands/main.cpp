@@ -1,51 +1,29 @@
 #include "mainwidget.h"
+#include "logger.h"
 
-QString functionName(QString func) {
-	func = func.left(func.indexOf('(')).trimmed();
-	return func.mid(func.lastIndexOf(' ')).trimmed();
-}
-
+// record is formatted by the writer thread of logger
 void messageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg)
 {
-	static const QString logName("log.txt");
-	
-	static const QMap<QtMsgType, QString> typeToString {
-		{ QtMsgType::QtDebugMsg, "debug" },
-		{ QtMsgType::QtWarningMsg, "warning" },
-		{ QtMsgType::QtCriticalMsg, "critical" },
-		{ QtMsgType::QtFatalMsg, "fatal" }
-	};
+	Logger::Record record = { QDateTime::currentMSecsSinceEpoch(), type, context.function, msg };
 
-	static volatile bool first = true;
-	if (first) { // lear log
-		first = false;
-		auto old = logName + ".old";
-		QFile::remove(old);
-		QDir::current().rename(logName, old);
+	auto logger = Logger::instance();
+	if (!logger) {
+		auto line = Logger::format(record);
+		fwrite(line.constData(), line.size(), 1, stdout);
+		return;
 	}
 
-	// Log line: <timestamp> <type>: <function> <message>
-	QString buffer;
-	QTextStream stream(&buffer);
-
-	stream << QDateTime::currentDateTime().toString("dd.MM.yyyy hh:mm:ss")
-		<< ' ' << typeToString.value(type)
-		<< ": " << functionName(context.function)
-		<< ' ' << msg << '\n';
-
-	auto local = buffer.toLocal8Bit();
-	
-	// Write to stdout and log file
-	fwrite(local, local.size(), 1, stdout);
-	QFile logFile(logName);
-	logFile.open(QFile::Append);
-	logFile.write(local);
+	logger->write(record);
+	if (type == QtFatalMsg) {
+		logger->flush();
+	}
 }
 
 int main(int argc, char *argv[])
 {
 	QApplication a(argc, argv);
 	
+	Logger logger("log.txt");
 	qInstallMessageHandler(messageHandler);
 	qDebug() << "start " << QDir::currentPath();
 
@@ -57,7 +35,16 @@ int main(int argc, char *argv[])
 		qWarning() << "don't load translations file";
 	}
 
-	MainWidget w;
-	w.show();
-	return a.exec();
+	auto result = 0;
+	{
+		MainWidget w;
+		w.show();
+		result = a.exec();
+	}
+
+	// threads of the pool may still log, so the handler is removed
+	// after them and before the logger is destroyed
+	QThreadPool::globalInstance()->waitForDone();
+	qInstallMessageHandler(nullptr);
+	return result;
 }
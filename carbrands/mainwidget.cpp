@@ -1,40 +1,171 @@
 #include "mainwidget.h"
+#include "treesnapshot.h"
 
 const QString& treeFileName() {
 	static const QString fileName("tree.xml");
 	return fileName;
 }
 
-qint64 writeAll(const QString& fileName, const QByteArray& data) {
-	QFile file(fileName);
+// two snapshot files: a new snapshot is written to the file,
+// which is not mapped by the model
+QString snapshotFileName(int slot) {
+	return QString("tree.%1.snapshot").arg(slot);
+}
 
-	if (!file.open(QFile::WriteOnly)) {
-		qWarning() << "can not open file " << fileName;
-		return 0;
-	}
+const QString& journalFileName() {
+	static const QString fileName("tree.journal");
+	return fileName;
+}
 
-	return file.write(data);
+// file of instrumentation report, it is enabled, if the variable is set
+const char* instrumentationVariable() {
+	return "CARBRANDS_INSTRUMENTATION";
 }
 
-QByteArray readAll(const QString& fileName) {
+enum { COMPACT_INTERVAL = 60 * 1000 };
+
+// sequence of the last journal record in snapshot or -1, if file is not a snapshot
+qint64 snapshotSequence(const QString& fileName) {
 	QFile file(fileName);
+	SnapshotHeader header;
+	if (!file.open(QFile::ReadOnly)
+		|| file.read(reinterpret_cast<char*>(&header), sizeof(header)) != qint64(sizeof(header))
+		|| header.magic != SnapshotHeader::MAGIC
+		|| header.version != SnapshotHeader::VERSION) {
+		return -1;
+	}
+	return qint64(header.sequence);
+}
+
+// true, if a snapshot file is left, even if it can not be opened
+bool hasSnapshot() {
+	return QFile::exists(snapshotFileName(0)) || QFile::exists(snapshotFileName(1));
+}
 
-	if (!file.open(QFile::ReadOnly)) {
+template <typename Write>
+bool writeFile(const QString& fileName, Write write) {
+	QSaveFile file(fileName);
+	if (!file.open(QFile::WriteOnly)) {
 		qWarning() << "can not open file " << fileName;
-		return {};
+		return false;
 	}
 
-	return file.readAll();
+	if (!write(&file) || !file.commit()) {
+		qWarning() << "can not write file " << fileName;
+		return false;
+	}
+	return true;
 }
 
 MainWidget::MainWidget(QWidget *parent)
-	: QWidget(parent)
+	: QWidget(parent),
+	snapshotSlot_(-1),
+	snapshotSequence_(0),
+	compactSlot_(-1),
+	compactSequence_(0),
+	compactWatcher_(new QFutureWatcher<bool>(this))
 {
+	if (qEnvironmentVariableIsSet(instrumentationVariable())) {
+		Instrumentation::setEnabled(true);
+	}
+
 	ui.setupUi(this);
 
-	ui.tree->deserialize(readAll(treeFileName()));
+	// tree.xml is imported only before the first snapshot is written, the journal
+	// records changes of the snapshot, so they are not replayed on tree.xml;
+	// if no snapshot can be opened, the files are left for recovery
+	quint64 sequence = 0;
+	auto isOpened = openSnapshot(&sequence);
+	if (!isOpened && hasSnapshot()) {
+		qWarning() << "can not open snapshot, changes will not be saved";
+	}
+	else {
+		if (!isOpened) {
+			QFile file(treeFileName());
+			if (!file.open(QFile::ReadOnly)) {
+				qWarning() << "can not open file " << treeFileName();
+			}
+
+			ui.tree->deserialize(&file);
+		}
+
+		if (!ui.tree->openJournal(journalFileName(), sequence)) {
+			qWarning() << "changes will not be saved";
+		}
+	}
+	snapshotSequence_ = sequence;
+
+	connect(ui.tree, &TreeWidget::snapshotTableBuilt, this, &MainWidget::writeSnapshot);
+	connect(compactWatcher_, &QFutureWatcher<bool>::finished, this, &MainWidget::compactFinished);
+
+	auto timer = new QTimer(this);
+	QObject::connect(timer, &QTimer::timeout, [this]() { compact(); });
+	timer->start(COMPACT_INTERVAL);
 }
 
+// the snapshot being written is completed, the later records are only synced
 void MainWidget::closeEvent(QCloseEvent*) {
-	writeAll(treeFileName(), ui.tree->serialize());
-}
\ No newline at end of file
+	// a table being built is dropped, the journal keeps its changes
+	disconnect(ui.tree, &TreeWidget::snapshotTableBuilt, this, &MainWidget::writeSnapshot);
+
+	if (compactWatcher_->isRunning()) {
+		compactWatcher_->disconnect(this);
+		compactWatcher_->waitForFinished();
+		compactFinished();
+	}
+
+	ui.tree->syncJournal();
+
+	if (Instrumentation::isEnabled()) {
+		Instrumentation::dump(QString::fromLocal8Bit(qgetenv(instrumentationVariable())));
+	}
+}
+
+// the newest of snapshots, which can be opened
+bool MainWidget::openSnapshot(quint64* sequence) {
+	qint64 sequences[] = { snapshotSequence(snapshotFileName(0)), snapshotSequence(snapshotFileName(1)) };
+	auto first = (sequences[1] > sequences[0]) ? 1 : 0;
+	for (auto slot : { first, 1 - first }) {
+		if (sequences[slot] >= 0 && ui.tree->openSnapshot(snapshotFileName(slot))) {
+			snapshotSlot_ = slot;
+			*sequence = quint64(sequences[slot]);
+			return true;
+		}
+	}
+	return false;
+}
+
+// tables of the tree are built in steps and written to snapshot by a worker thread,
+// if journal has records after the last snapshot
+void MainWidget::compact() {
+	if (compactWatcher_->isRunning() || ui.tree->isBuildingSnapshotTable()
+		|| ui.tree->journalSequence() == snapshotSequence_) {
+		return;
+	}
+
+	ui.tree->buildSnapshotTable();
+}
+
+void MainWidget::writeSnapshot(const SnapshotTable& table) {
+	compactSlot_ = (snapshotSlot_ == 0) ? 1 : 0;
+	auto fileName = snapshotFileName(compactSlot_);
+	compactSequence_ = table.header.sequence;
+	compactWatcher_->setFuture(QtConcurrent::run([fileName, table]() {
+		return writeFile(fileName, [&table](QIODevice* device) { return table.write(device); });
+	}));
+}
+
+void MainWidget::compactFinished() {
+	auto future = compactWatcher_->future();
+	if (future.isCanceled() || !future.result()) {
+		return;
+	}
+
+	// the other snapshot may be left from older sessions
+	if (snapshotSlot_ == -1) {
+		QFile::remove(snapshotFileName(1 - compactSlot_));
+	}
+
+	snapshotSequence_ = compactSequence_;
+	ui.tree->compactJournal();
+}
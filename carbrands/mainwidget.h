@@ -15,8 +15,21 @@ public:
 protected:
 	virtual void closeEvent(QCloseEvent*) Q_DECL_OVERRIDE;
 
+private slots:
+	void writeSnapshot(const SnapshotTable& table);
+	void compactFinished();
+
+private:
+	bool openSnapshot(quint64* sequence);
+	void compact();
+
 private:
 	Ui::MainWidget ui;
+	int snapshotSlot_;
+	quint64 snapshotSequence_;
+	int compactSlot_;
+	quint64 compactSequence_;
+	QFutureWatcher<bool>* compactWatcher_;
 };
 
 #endif // MAINWIDGET_H
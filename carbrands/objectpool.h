@@ -0,0 +1,104 @@
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <QtCore>
+#include <algorithm>
+#include <functional>
+#include <new>
+#include <type_traits>
+
+// Pool of objects allocated from slabs.
+// Free slots are kept in a list and reused, the slabs are released only
+// by clear() or the destructor, which destroy all live objects in one
+// linear pass over the slabs instead of freeing them one by one.
+template <typename T>
+class ObjectPool
+{
+public:
+	enum { SLAB_SIZE = 1024 };
+
+public:
+	ObjectPool() : slabs_(), free_(nullptr), size_(0) {}
+
+	~ObjectPool() {
+		clear();
+	}
+
+	int size() const {
+		return size_;
+	}
+
+	template <typename... Args>
+	T* create(Args&&... args) {
+		if (!free_) {
+			grow();
+		}
+
+		auto slot = free_;
+		free_ = slot->next;
+		++size_;
+
+		return new (&slot->storage) T(std::forward<Args>(args)...);
+	}
+
+	void destroy(T* object) {
+		object->~T();
+
+		auto slot = reinterpret_cast<Slot*>(object);
+		slot->next = free_;
+		free_ = slot;
+		--size_;
+	}
+
+	void clear() {
+		auto slabs = slabs_;
+		std::sort(slabs.begin(), slabs.end(), std::less<Slot*>());
+
+		QVector<QBitArray> freeSlots(slabs.size(), QBitArray(SLAB_SIZE));
+		for (auto slot = free_; slot; slot = slot->next) {
+			auto slab = std::upper_bound(
+				slabs.begin(), slabs.end(), slot, std::less<Slot*>()
+			) - 1;
+			freeSlots[slab - slabs.begin()].setBit(static_cast<int>(slot - *slab));
+		}
+
+		for (int i = 0; i < slabs.size(); ++i) {
+			for (int j = 0; j < SLAB_SIZE; ++j) {
+				if (!freeSlots[i].testBit(j)) {
+					reinterpret_cast<T*>(&slabs[i][j].storage)->~T();
+				}
+			}
+			delete[] slabs[i];
+		}
+
+		slabs_.clear();
+		free_ = nullptr;
+		size_ = 0;
+	}
+
+private:
+	Q_DISABLE_COPY(ObjectPool)
+
+	union Slot {
+		Slot* next;
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+	};
+
+	void grow() {
+		auto slab = new Slot[SLAB_SIZE];
+		slabs_.push_back(slab);
+
+		// reversed, so objects are created in address order
+		for (int i = SLAB_SIZE - 1; i >= 0; --i) {
+			slab[i].next = free_;
+			free_ = &slab[i];
+		}
+	}
+
+private:
+	QVector<Slot*> slabs_;
+	Slot* free_;
+	int size_;
+};
+
+#endif // OBJECTPOOL_H
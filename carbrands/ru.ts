@@ -17,9 +17,29 @@
         <translation>Марки машин</translation>
     </message>
     <message>
-        <location filename="mainwidget.ui" line="42"/>
+        <location filename="mainwidget.ui" line="47"/>
         <source>Search</source>
         <translation>Поиск</translation>
     </message>
+    <message>
+        <location filename="mainwidget.ui" line="54"/>
+        <source>Show the best approximate matches</source>
+        <translation>Показать лучшие приближённые совпадения</translation>
+    </message>
+    <message>
+        <location filename="mainwidget.ui" line="57"/>
+        <source>Fuzzy</source>
+        <translation>Нечётко</translation>
+    </message>
+    <message>
+        <location filename="mainwidget.ui" line="64"/>
+        <source>Sort items by name</source>
+        <translation>Сортировать элементы по имени</translation>
+    </message>
+    <message>
+        <location filename="mainwidget.ui" line="67"/>
+        <source>Sort</source>
+        <translation>Сортировка</translation>
+    </message>
 </context>
 </TS>
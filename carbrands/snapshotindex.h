@@ -0,0 +1,183 @@
+#ifndef SNAPSHOTINDEX_H
+#define SNAPSHOTINDEX_H
+
+#include <QtCore>
+
+#include "textmatcher.h"
+#include "treesnapshot.h"
+#include "trigramindex.h"
+
+// Substring index of the nodes of a lazily opened snapshot.
+// Equal labels share data in the snapshot, so each distinct data is one
+// text, which is indexed by its trigrams and keeps the list of its nodes.
+// A node is loaded, when the children of its parent are fetched, loaded
+// nodes are not found. The index is built once by the first caller of
+// build(), find() or labels(), it can be searched from any thread, while
+// the snapshot stays mapped.
+class SnapshotIndex
+{
+public:
+	explicit SnapshotIndex(const SnapshotView& snapshot)
+		: snapshot_(snapshot),
+		fetched_(new QAtomicInt[snapshot.nodeCount()]),
+		mutex_(),
+		isBuilt_(false),
+		texts_(),
+		labels_(),
+		nodes_(),
+		trigrams_() {}
+
+	void build() const {
+		QMutexLocker locker(&mutex_);
+		if (isBuilt_) {
+			return;
+		}
+
+		// nodes are grouped by text, offsets of groups are the sums of their sizes
+		QHash<quint64, int> textIds;
+		QVector<int> nodeTexts(snapshot_.nodeCount(), -1);
+		for (int i = 1; i < snapshot_.nodeCount(); ++i) {
+			auto& node = snapshot_.node(i);
+			auto key = (quint64(node.dataOffset) << 32) | node.dataSize;
+			auto it = textIds.find(key);
+			if (it == textIds.end()) {
+				it = textIds.insert(key, texts_.size());
+				texts_.push_back({ i, 0, 0 });
+			}
+			nodeTexts[i] = it.value();
+			++texts_[it.value()].nodeCount;
+		}
+
+		int offset = 0;
+		for (auto& text : texts_) {
+			text.firstNode = offset;
+			offset += text.nodeCount;
+		}
+
+		QVector<int> ends(texts_.size());
+		for (int i = 0; i < texts_.size(); ++i) {
+			ends[i] = texts_[i].firstNode;
+		}
+
+		nodes_.resize(offset);
+		for (int i = 1; i < snapshot_.nodeCount(); ++i) {
+			nodes_[ends[nodeTexts[i]]++] = i;
+		}
+
+		labels_.reserve(texts_.size());
+		for (int i = 0; i < texts_.size(); ++i) {
+			for (auto key : trigramKeys(snapshot_.rawData(texts_[i].node))) {
+				trigrams_[key].push_back(i);
+			}
+			labels_.push_back({ snapshot_.data(texts_[i].node), texts_[i].nodeCount });
+		}
+
+		isBuilt_ = true;
+	}
+
+	// children of node are loaded
+	void setFetched(int node) {
+		fetched_[node].storeRelease(1);
+	}
+
+	bool isLoaded(int node) const {
+		auto parent = snapshot_.node(node).parent;
+		return parent < 0 || fetched_[parent].loadAcquire() != 0;
+	}
+
+	// nodes, which are not loaded and which data contains text case insensitive,
+	// at most limit of them, a canceled search stops between texts
+	QVector<int> find(const QString& text, int limit, const SearchToken& token = SearchToken()) const {
+		TextMatcher matcher(text);
+		return findNodes(text, limit, [&matcher](const QString& data) { return matcher.contains(data); }, token);
+	}
+
+	// nodes, which are not loaded and which data is text, at most limit of them
+	QVector<int> findExact(const QString& text, int limit) const {
+		return findNodes(text, limit, [&text](const QString& data) { return data == text; });
+	}
+
+	// copies of distinct data with the number of their nodes, e.g. for fuzzy search
+	QVector<Label> labels() const {
+		build();
+		return labels_;
+	}
+
+private:
+	Q_DISABLE_COPY(SnapshotIndex)
+
+	// texts, which contain trigrams of text, are checked by accept,
+	// all texts are checked, if text is shorter than a trigram
+	template <typename Accept>
+	QVector<int> findNodes(const QString& text, int limit, Accept accept, const SearchToken& token = SearchToken()) const {
+		build();
+
+		QVector<int> found;
+		auto append = [this, &found, &accept, limit](int textId) {
+			auto& entry = texts_[textId];
+			if (!accept(snapshot_.rawData(entry.node))) {
+				return true;
+			}
+
+			for (int i = entry.firstNode; i < entry.firstNode + entry.nodeCount; ++i) {
+				if (!isLoaded(nodes_[i])) {
+					found.push_back(nodes_[i]);
+					if (found.size() >= limit) {
+						return false;
+					}
+				}
+			}
+			return true;
+		};
+
+		auto keys = trigramKeys(text);
+		if (keys.isEmpty()) {
+			for (int i = 0; i < texts_.size(); ++i) {
+				if (token.isCanceled() || !append(i)) {
+					break;
+				}
+			}
+			return found;
+		}
+
+		const QVector<int>* rarest = nullptr;
+		for (auto key : keys) {
+			auto it = trigrams_.find(key);
+			if (it == trigrams_.end()) {
+				return found;
+			}
+
+			if (!rarest || it.value().size() < rarest->size()) {
+				rarest = &it.value();
+			}
+		}
+
+		for (auto textId : *rarest) {
+			if (token.isCanceled() || !append(textId)) {
+				break;
+			}
+		}
+		return found;
+	}
+
+	// distinct data, node is one of the nodes with it, the nodes are
+	// nodes_[firstNode] .. nodes_[firstNode + nodeCount - 1]
+	struct Text {
+		int node;
+		int firstNode;
+		int nodeCount;
+	};
+
+private:
+	SnapshotView snapshot_;
+	QScopedArrayPointer<QAtomicInt> fetched_;
+
+	mutable QMutex mutex_;
+	mutable bool isBuilt_;
+	mutable QVector<Text> texts_;
+	mutable QVector<Label> labels_;
+	mutable QVector<int> nodes_;
+	mutable QHash<quint64, QVector<int>> trigrams_;
+};
+
+#endif // SNAPSHOTINDEX_H
@@ -1,11 +1,22 @@
 #include "sortfilterproxymodel.h"
+#include <QTimer>
 #include <qdebug.h>
 
 SortFilterProxyModel::SortFilterProxyModel(QObject* parent) :
 	QSortFilterProxyModel(parent),
 	cache_(),
+	matchRanges_(),
 	regExpCache_(),
-	sourceModelCache_(nullptr)
+	candidateFinder_(),
+	comparator_(),
+	matcher_(),
+	isMatcherUsed_(false),
+	refinements_(),
+	expandIndexes_(),
+	isExpandValid_(false),
+	rankedMatches_(),
+	isRanked_(false),
+	isInvalidateScheduled_(false)
 {}
 
 bool acceptData(const QRegExp& regExp, const QVariant& data) {
@@ -13,14 +24,58 @@ bool acceptData(const QRegExp& regExp, const QVariant& data) {
 	return string.isEmpty() || regExp.isEmpty() || string.contains(regExp);
 }
 
+// item or one of its descendants matches
+bool isMatched(const SortFilterProxyModel::CacheItem& item) {
+	return item.isMatch || item.matchedChildren > 0;
+}
+
+bool isAccepted(const SortFilterProxyModel::CacheItem& item) {
+	return isMatched(item) || item.isAncestorMatch;
+}
+
 void SortFilterProxyModel::clearCache() const {
+	Instrumentation::count(Instrumentation::CACHE_CLEAR);
 	cache_.clear();
+	matchRanges_.clear();
+	regExpCache_ = QRegExp();
+	refinements_.clear();
+	expandIndexes_.clear();
+	isExpandValid_ = false;
+}
+
+// cache is updated before the base class filters the changed rows,
+// so the cache slots are connected before the base class slots
+void SortFilterProxyModel::setSourceModel(QAbstractItemModel* sourceModel) {
+	if (this->sourceModel()) {
+		disconnect(this->sourceModel(), 0, this, 0);
+	}
+
+	if (sourceModel) {
+		connect(sourceModel, &QAbstractItemModel::dataChanged,
+			this, &SortFilterProxyModel::sourceDataChanged);
+
+		connect(sourceModel, &QAbstractItemModel::rowsInserted,
+			this, &SortFilterProxyModel::sourceRowsInserted);
+
+		connect(sourceModel, &QAbstractItemModel::rowsAboutToBeRemoved,
+			this, &SortFilterProxyModel::sourceRowsAboutToBeRemoved);
+
+		connect(sourceModel, &QAbstractItemModel::modelReset,
+			this, &SortFilterProxyModel::clearCache);
+
+		connect(sourceModel, &QAbstractItemModel::layoutChanged,
+			this, &SortFilterProxyModel::sourceLayoutChanged);
+	}
+
+	clearCache();
+	QSortFilterProxyModel::setSourceModel(sourceModel);
 }
 
 bool SortFilterProxyModel::setData(const QModelIndex &index, const QVariant& value, int role) {
 	auto filterRole = this->filterRole();
-	if (role == filterRole
-		|| (filterRole == Qt::DisplayRole && role == Qt::EditRole)) {
+	// ranked matches are not checked by data
+	if (!isRanked_ && (role == filterRole
+		|| (filterRole == Qt::DisplayRole && role == Qt::EditRole))) {
 		if (!acceptData(filterRegExp(), value)) {
 			return false;
 		}
@@ -29,128 +84,562 @@ bool SortFilterProxyModel::setData(const QModelIndex &index, const QVariant& val
 	return QSortFilterProxyModel::setData(index, value);
 }
 
-void SortFilterProxyModel::updateCache() const {
-	bool recache = false;
+// cache
+///////////////////////////////////////////////////////////////////////////////
+// true, if the cache is built again for the new filter
+bool SortFilterProxyModel::updateCache() const {
+	auto regExp = filterRegExp();
+	if (regExpCache_ == regExp) {
+		return false;
+	}
+
+	InstrumentationTimer timer(Instrumentation::FILTER_BUILD);
+
+	cache_.clear();
+	matchRanges_.clear();
+	regExpCache_ = regExp;
+	expandIndexes_.clear();
+	isExpandValid_ = true;
+	isMatcherUsed_ = regExp.patternSyntax() == QRegExp::FixedString
+		&& regExp.caseSensitivity() == Qt::CaseInsensitive;
+	matcher_ = TextMatcher((isMatcherUsed_) ? regExp.pattern() : QString());
+	if (!isMatcherUsed_) {
+		refinements_.clear();
+	}
+
+	if (!isFiltered() || !sourceModel()) {
+		return true;
+	}
+
+	QVector<QModelIndex> matches;
+	if (isRanked_) {
+		for (auto& match : rankedMatches_) {
+			if (match.isValid()) {
+				matches.push_back(match);
+			}
+		}
+		buildFromMatches(&matches);
+		return true;
+	}
+
+	// candidates are found by the current text, e.g. with the items fetched
+	// since an earlier filter, so they are preferred to the refinement
+	auto isCandidates = buildFromCandidates(&matches);
+	if (!isCandidates && !buildFromRefinement(&matches)) {
+		build(QModelIndex(), false, &matches);
+	}
+
+	if (isMatcherUsed_ && !isCandidates) {
+		pushRefinement(matches);
+	}
+	return true;
+}
+
+void SortFilterProxyModel::setCandidateFinder(const CandidateFinder& finder) {
+	candidateFinder_ = finder;
+	clearCache();
+	invalidateFilter();
+}
+
+void SortFilterProxyModel::setComparator(const Comparator& comparator) {
+	comparator_ = comparator;
+	if (sortColumn() >= 0) {
+		invalidate();
+	}
+}
+
+void SortFilterProxyModel::setRankedFilter(const QString& text, const QModelIndexList& matches) {
+	isRanked_ = true;
+	rankedMatches_.clear();
+	for (auto& match : matches) {
+		rankedMatches_.push_back(match);
+	}
+
+	clearCache();
+	setFilterFixedString(text);
+}
+
+void SortFilterProxyModel::clearRankedFilter() {
+	if (!isRanked_) {
+		return;
+	}
+
+	isRanked_ = false;
+	rankedMatches_.clear();
+	clearCache();
+	invalidateFilter();
+}
+
+// case insensitive fixed strings, used by search, are matched without copies of data,
+// in ranked mode only empty data, e.g. of a new row, matches, as the matches are set,
+// range is found for fixed strings only
+bool SortFilterProxyModel::acceptsData(const QVariant& data, MatchRange* range) const {
+	if (!isRanked_ && !isMatcherUsed_) {
+		return acceptData(regExpCache_, data);
+	}
+
+	auto string = data.toString();
+	if (TextMatcher::isBlank(string.constData(), string.size())) {
+		return true;
+	}
+
+	if (isRanked_) {
+		return false;
+	}
+
+	int length = 0;
+	auto position = matcher_.indexOf(string, &length);
+	if (position == -1) {
+		return false;
+	}
+
+	if (range) {
+		*range = { position, length };
+	}
+	return true;
+}
+
+// match range of item is recorded once by the filter pass, not by each paint
+bool SortFilterProxyModel::matchIndex(const QModelIndex& sourceIndex) const {
+	MatchRange range = { 0, 0 };
+	auto isMatch = acceptsData(sourceIndex.data(filterRole()), &range);
+	if (range.length > 0) {
+		matchRanges_.insert(sourceIndex.internalPointer(), range);
+	}
+	else {
+		matchRanges_.remove(sourceIndex.internalPointer());
+	}
+	return isMatch;
+}
+
+QVariant SortFilterProxyModel::data(const QModelIndex& index, int role) const {
+	if (role != MATCH_RANGE_ROLE) {
+		return QSortFilterProxyModel::data(index, role);
+	}
+
+	auto it = matchRanges_.find(mapToSource(index).internalPointer());
+	return (it != matchRanges_.end()) ? QVariant::fromValue(it.value()) : QVariant();
+}
+
+bool SortFilterProxyModel::isFiltered() const {
+	return !regExpCache_.isEmpty();
+}
+
+SortFilterProxyModel::CacheItem SortFilterProxyModel::cacheItem(const QModelIndex& sourceIndex) const {
+	auto it = cache_.find(sourceIndex.internalPointer());
+	if (it != cache_.end()) {
+		Instrumentation::count(Instrumentation::CACHE_HIT);
+		return it.value();
+	}
+
+	Instrumentation::count(Instrumentation::CACHE_MISS);
+	return CacheItem{ false, isAncestorMatch(sourceIndex.parent()), 0 };
+}
+
+// true, if parent or one of its ancestors matches,
+// items between parent and its nearest stored ancestor do not match
+bool SortFilterProxyModel::isAncestorMatch(const QModelIndex& sourceParent) const {
+	for (auto index = sourceParent; index.isValid(); index = index.parent()) {
+		auto it = cache_.find(index.internalPointer());
+		if (it != cache_.end()) {
+			return it.value().isMatch || it.value().isAncestorMatch;
+		}
+	}
+	return false;
+}
+
+void SortFilterProxyModel::setCacheItem(const QModelIndex& sourceIndex, const CacheItem& item) const {
+	if (isMatched(item)) {
+		cache_.insert(sourceIndex.internalPointer(), item);
+	}
+	else {
+		cache_.remove(sourceIndex.internalPointer());
+	}
+}
 
+// one pass over the subtree: the ancestor match goes down before
+// the children are visited, the matched children are counted after
+bool SortFilterProxyModel::build(
+	const QModelIndex& sourceIndex,
+	bool isAncestorMatch,
+	QVector<QModelIndex>* matches
+) const {
 	auto sourceModel = this->sourceModel();
-	if (sourceModelCache_ != sourceModel) {
-		if (sourceModelCache_) {
-			disconnect(sourceModelCache_, 0, this, 0);
+	CacheItem item = {
+		sourceIndex.isValid() && matchIndex(sourceIndex),
+		isAncestorMatch,
+		0
+	};
+
+	if (item.isMatch && matches) {
+		matches->push_back(sourceIndex);
+	}
+
+	auto column = filterKeyColumn();
+	auto rowCount = sourceModel->rowCount(sourceIndex);
+	for (int row = 0; row < rowCount; ++row) {
+		auto childIndex = sourceModel->index(row, column, sourceIndex);
+		if (build(childIndex, isAncestorMatch || item.isMatch, matches)) {
+			++item.matchedChildren;
 		}
+	}
 
-		if (sourceModel) {
-			connect(sourceModel, SIGNAL(dataChanged(QModelIndex, QModelIndex)), this, SLOT(clearCache()));
+	if (sourceIndex.isValid()) {
+		setCacheItem(sourceIndex, item);
+		if (item.matchedChildren > 0) {
+			expandIndexes_.push_back(sourceIndex);
+		}
+	}
+	return isMatched(item);
+}
 
-			connect(sourceModel, SIGNAL(rowsInserted(QModelIndex, int, int)), this, SLOT(clearCache()));
+// matches are checked among the candidates of the candidate finder
+bool SortFilterProxyModel::buildFromCandidates(QVector<QModelIndex>* matches) const {
+	QModelIndexList candidates;
+	if (!candidateFinder_ || !candidateFinder_(regExpCache_, &candidates)) {
+		return false;
+	}
 
-			connect(sourceModel, SIGNAL(rowsRemoved(QModelIndex, int, int)), this, SLOT(clearCache()));
+	for (auto& candidate : candidates) {
+		if (candidate.isValid() && matchIndex(candidate)) {
+			matches->push_back(candidate);
 		}
+	}
 
-		sourceModelCache_ = sourceModel;
-		recache = true;
+	buildFromMatches(matches);
+	return true;
+}
+
+// when the text is extended, only the matches of the earlier text are checked,
+// when it is shortened back, the matches of the earlier text are restored
+bool SortFilterProxyModel::buildFromRefinement(QVector<QModelIndex>* matches) const {
+	if (!isMatcherUsed_) {
+		return false;
 	}
 
-	auto regExp = filterRegExp();
-	if (regExpCache_ != regExp) {
-		regExpCache_ = regExp;
-		recache = true;
+	auto pattern = regExpCache_.pattern();
+	while (!refinements_.isEmpty() && !refinements_.back().matcher.contains(pattern)) {
+		refinements_.pop_back();
 	}
 
-	if (recache) {
-		clearCache();
+	if (refinements_.isEmpty()) {
+		return false;
+	}
+
+	auto& refinement = refinements_.back();
+	if (refinement.matcher.text().compare(pattern, Qt::CaseInsensitive) == 0) {
+		*matches = refinement.matches;
+		matchRanges_ = refinement.ranges;
+	}
+	else {
+		for (auto& index : refinement.matches) {
+			if (matchIndex(index)) {
+				matches->push_back(index);
+			}
+		}
 	}
+
+	buildFromMatches(matches);
+	return true;
 }
 
-SortFilterProxyModel::CacheItem& 
-	SortFilterProxyModel::cachedAccept(
-		const QModelIndex& sourceIndex,
-		bool* inCachePtr
-) const {
-	auto it = cache_.find(sourceIndex);
-	
-	bool inCache = it != cache_.end();
-	if (inCachePtr) {
-		*inCachePtr = inCache;
+// only the matched items and their ancestors are visited,
+// repeated matches are removed from the list
+void SortFilterProxyModel::buildFromMatches(QVector<QModelIndex>* matches) const {
+	int count = 0;
+	for (int i = 0; i < matches->size(); ++i) {
+		auto match = matches->at(i);
+		auto& item = cache_[match.internalPointer()];
+		if (item.isMatch) {
+			continue;
+		}
+
+		auto wasMatched = isMatched(item);
+		item.isMatch = true;
+		(*matches)[count++] = match;
+
+		auto delta = (wasMatched) ? 0 : 1;
+		for (auto index = match.parent(); index.isValid() && delta != 0; index = index.parent()) {
+			auto& parentItem = cache_[index.internalPointer()];
+			delta = (isMatched(parentItem)) ? 0 : 1;
+			if (++parentItem.matchedChildren == 1) {
+				expandIndexes_.push_back(index);
+			}
+		}
 	}
+	matches->resize(count);
 
-	if (inCache) {
-		return it.value();
+	// ancestor match goes down the paths to the matches
+	for (auto& match : *matches) {
+		QVector<QModelIndex> path;
+		for (auto index = match; index.isValid(); index = index.parent()) {
+			path.push_back(index);
+		}
+
+		bool isAncestorMatch = false;
+		for (int i = path.size() - 1; i >= 0; --i) {
+			auto& item = cache_[path[i].internalPointer()];
+			item.isAncestorMatch = isAncestorMatch;
+			isAncestorMatch = isAncestorMatch || item.isMatch;
+		}
+	}
+}
+
+// the stack holds narrowing texts, the matches of the same text are replaced
+void SortFilterProxyModel::pushRefinement(const QVector<QModelIndex>& matches) const {
+	auto pattern = regExpCache_.pattern();
+	if (!refinements_.isEmpty()
+		&& refinements_.back().matcher.text().compare(pattern, Qt::CaseInsensitive) == 0) {
+		refinements_.pop_back();
+	}
+
+	auto total = matches.size();
+	for (auto& refinement : refinements_) {
+		total += refinement.matches.size();
+	}
+
+	while (!refinements_.isEmpty()
+		&& (refinements_.size() >= MAX_REFINEMENTS || total > MAX_REFINEMENT_MATCHES)) {
+		total -= refinements_.front().matches.size();
+		refinements_.pop_front();
 	}
 
-	auto filterData = sourceModel()->data(sourceIndex, this->filterRole());
+	if (matches.size() <= MAX_REFINEMENT_MATCHES) {
+		refinements_.push_back({ matcher_, matches, matchRanges_ });
+	}
+}
+
+// items without stored state have no stored descendants
+int SortFilterProxyModel::removeTree(const QModelIndex& sourceIndex) {
+	auto it = cache_.find(sourceIndex.internalPointer());
+	if (it == cache_.end()) {
+		return 0;
+	}
+
+	auto matched = isMatched(it.value()) ? 1 : 0;
+	cache_.erase(it);
+	matchRanges_.remove(sourceIndex.internalPointer());
+
+	auto column = filterKeyColumn();
+	auto rowCount = sourceModel()->rowCount(sourceIndex);
+	for (int row = 0; row < rowCount; ++row) {
+		removeTree(sourceModel()->index(row, column, sourceIndex));
+	}
+
+	return matched;
+}
+
+// ancestors are updated, while their matched state changes
+void SortFilterProxyModel::updateMatchedChildren(const QModelIndex& sourceIndex, int delta) {
+	for (auto index = sourceIndex; index.isValid() && delta != 0; index = index.parent()) {
+		auto item = cacheItem(index);
+		auto wasMatched = isMatched(item);
+		auto wasAccepted = isAccepted(item);
+
+		item.matchedChildren += delta;
+		setCacheItem(index, item);
+
+		if (wasAccepted != isAccepted(item)) {
+			scheduleInvalidate();
+		}
+		delta = int(isMatched(item)) - int(wasMatched);
+	}
+}
+
+// stored descendants are updated down to the items, which match themselves
+void SortFilterProxyModel::updateAncestorMatch(const QModelIndex& sourceIndex, bool isAncestorMatch) {
+	auto it = cache_.find(sourceIndex.internalPointer());
+	if (it == cache_.end()) {
+		// acceptance of item is derived from its ancestors
+		scheduleInvalidate();
+		return;
+	}
+
+	auto& item = it.value();
+	if (item.isAncestorMatch == isAncestorMatch) {
+		return;
+	}
 
-	auto acceptData = ::acceptData(filterRegExp(), filterData);
+	item.isAncestorMatch = isAncestorMatch;
+	if (item.isMatch) {
+		return;
+	}
 
-	return cache_.insert(sourceIndex, { acceptData, false }).value();
+	auto column = filterKeyColumn();
+	auto rowCount = sourceModel()->rowCount(sourceIndex);
+	for (int row = 0; row < rowCount; ++row) {
+		updateAncestorMatch(sourceModel()->index(row, column, sourceIndex), isAncestorMatch);
+	}
 }
 
+// rows other than the changed ones are filtered again once,
+// after the current change
+void SortFilterProxyModel::scheduleInvalidate() {
+	if (isInvalidateScheduled_) {
+		return;
+	}
+
+	isInvalidateScheduled_ = true;
+	QTimer::singleShot(0, this, [this]() {
+		isInvalidateScheduled_ = false;
+		invalidateFilter();
+	});
+}
+
+// matches of earlier texts may change with the data, so they are dropped
+void SortFilterProxyModel::sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+	refinements_.clear();
+	if (updateCache() || !isFiltered() || isRanked_) {
+		return;
+	}
+
+	isExpandValid_ = false;
+
+	for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+		auto index = topLeft.sibling(row, topLeft.column());
+		auto item = cacheItem(index);
+		auto isMatch = matchIndex(index);
+		if (isMatch == item.isMatch) {
+			continue;
+		}
+
+		auto wasMatched = isMatched(item);
+		item.isMatch = isMatch;
+		setCacheItem(index, item);
+
+		if (!item.isAncestorMatch) {
+			auto column = filterKeyColumn();
+			auto rowCount = sourceModel()->rowCount(index);
+			for (int childRow = 0; childRow < rowCount; ++childRow) {
+				updateAncestorMatch(sourceModel()->index(childRow, column, index), isMatch);
+			}
+		}
+
+		updateMatchedChildren(index.parent(), int(isMatched(item)) - int(wasMatched));
+	}
+}
+
+void SortFilterProxyModel::sourceRowsInserted(const QModelIndex& parent, int first, int last) {
+	refinements_.clear();
+	if (updateCache() || !isFiltered()) {
+		return;
+	}
+
+	isExpandValid_ = false;
+	auto parentItem = cacheItem(parent);
+	auto isAncestorMatch = parentItem.isMatch || parentItem.isAncestorMatch;
+
+	int matched = 0;
+	auto column = filterKeyColumn();
+	for (int row = first; row <= last; ++row) {
+		if (build(sourceModel()->index(row, column, parent), isAncestorMatch)) {
+			++matched;
+		}
+	}
+
+	updateMatchedChildren(parent, matched);
+}
+
+// a sort keeps the items and their data, so their cached state is still valid
+void SortFilterProxyModel::sourceLayoutChanged(
+	const QList<QPersistentModelIndex>&,
+	QAbstractItemModel::LayoutChangeHint hint
+) {
+	if (hint != QAbstractItemModel::VerticalSortHint) {
+		clearCache();
+	}
+}
+
+// items of removed rows may be reused for new rows, so their entries are removed
+void SortFilterProxyModel::sourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last) {
+	updateCache();
+	refinements_.clear();
+	isExpandValid_ = false;
+	if (!isFiltered()) {
+		return;
+	}
+
+	int matched = 0;
+	auto column = filterKeyColumn();
+	for (int row = first; row <= last; ++row) {
+		matched += removeTree(sourceModel()->index(row, column, parent));
+	}
+
+	updateMatchedChildren(parent, -matched);
+}
+
+// filter
+///////////////////////////////////////////////////////////////////////////////
 bool SortFilterProxyModel::filterAcceptsRow(
 	int sourceRow, 
 	const QModelIndex &sourceParent
 ) const {
+	InstrumentationTimer timer(Instrumentation::FILTER_ACCEPTS_ROW);
 	updateCache();
+	if (!isFiltered()) {
+		return true;
+	}
 
 	auto sourceModel = this->sourceModel();
 	if (!sourceModel) {
 		qWarning() << "source model is null";
 		return true;
 	}
-	
-	auto makeIndex = [sourceModel, this](int row, const QModelIndex &parent) {
-		return sourceModel->index(row, this->filterKeyColumn(), parent);
-	};
 
-	auto sourceIndex = makeIndex(sourceRow, sourceParent);
+	auto sourceIndex = sourceModel->index(sourceRow, filterKeyColumn(), sourceParent);
 	if (!sourceIndex.isValid()) {
 		qWarning() << "invalid source model index";
 		return true;
 	}
 
-	bool inCache;
-	auto& cacheItem = cachedAccept(sourceIndex, &inCache);
+	return isAccepted(cacheItem(sourceIndex));
+}
 
-	if (inCache || cacheItem.isAccept) {
-		return cacheItem.isAccept;
+// filtered items with matched descendants, they are collected by the build
+// of the filter, the rows are walked only after the source is changed
+QModelIndexList SortFilterProxyModel::indexesExpand() const {
+	QModelIndexList expandItems;
+	if (!isFiltered()) {
+		return expandItems;
 	}
-	
-	if (sourceIndex.isValid()){
-		auto rowCount = sourceModel->rowCount(sourceIndex);
-		for (int i = 0; i < rowCount; ++i){
-			if (cachedAccept(makeIndex(i, sourceIndex)).isAccept) {
-				return (cacheItem.isExpand = true);
+
+	if (isExpandValid_) {
+		expandItems.reserve(expandIndexes_.size());
+		for (auto& sourceIndex : expandIndexes_) {
+			auto index = mapFromSource(sourceIndex);
+			if (index.isValid()) {
+				expandItems.push_back(index);
 			}
 		}
+		return expandItems;
 	}
 
-	auto parent = sourceParent;
-	while (parent.isValid()) {
-		if (cachedAccept(parent).isAccept) {
-			return true;
+	QVector<QModelIndex> parents(1, QModelIndex());
+	while (!parents.isEmpty()) {
+		auto parent = parents.takeLast();
+		auto rowCount = this->rowCount(parent);
+		for (int row = 0; row < rowCount; ++row) {
+			auto index = this->index(row, 0, parent);
+			if (cacheItem(mapToSource(index)).matchedChildren > 0) {
+				expandItems.push_back(index);
+				parents.push_back(index);
+			}
 		}
-		parent = parent.parent();
 	}
 
-	return false;
+	return expandItems;
 }
 
-QSet<QModelIndex> SortFilterProxyModel::indexesExpand() const {
-	QSet<QModelIndex> expandItems;
-	for (auto it = cache_.begin(); it != cache_.end(); ++it) {
-		if (it.value().isExpand) {
-			auto index = it.key();
-			if (index.isValid()) {
-				expandItems.insert(index);
-			}
-		}
-	}
-
-	QSet<QModelIndex> proxyExpandItems;
-	for (auto& expandItem : expandItems) {
-		auto index = mapFromSource(expandItem);
-		if (index.isValid()) {
-			proxyExpandItems.insert(index);
-		}
+// sort
+///////////////////////////////////////////////////////////////////////////////
+// strings are not compared by each call, the comparator uses cached keys
+bool SortFilterProxyModel::lessThan(
+	const QModelIndex& sourceLeft,
+	const QModelIndex& sourceRight
+) const {
+	if (!comparator_ || sortRole() != Qt::DisplayRole) {
+		return QSortFilterProxyModel::lessThan(sourceLeft, sourceRight);
 	}
 
-	return proxyExpandItems;
+	return comparator_(sourceLeft, sourceRight) < 0;
 }
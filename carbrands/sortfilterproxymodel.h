@@ -2,48 +2,147 @@
 #define SORTFILTERPROXYMODEL_H
 
 #include <QSortFilterProxyModel>
+#include <functional>
+
+#include "instrumentation.h"
+#include "textmatcher.h"
 
 class SortFilterProxyModel : public QSortFilterProxyModel
 {
 	Q_OBJECT
 
 public:
+	// filter state of item, only items, which match or have matched
+	// descendants, are stored, the state of other items is derived
+	// from their nearest stored ancestor
 	struct CacheItem {
-		bool isAccept;
-		bool isExpand;
+		bool isMatch;         // data of item matches
+		bool isAncestorMatch; // data of an ancestor matches
+		int matchedChildren;  // children, which match or have matched descendants
+	};
+
+	// cache is keyed by internal pointer of source index, which does not
+	// change, when rows are inserted or removed before the item
+	typedef QHash<const void*, CacheItem> Cache;
+
+	// matched units of item data, for highlight
+	struct MatchRange {
+		int position;
+		int length;
+	};
+
+	// match ranges of matched items, keyed as the cache
+	typedef QHash<const void*, MatchRange> MatchRanges;
+
+	// data role of MatchRange of proxy index, invalid for items without range
+	enum { MATCH_RANGE_ROLE = Qt::UserRole + 1 };
+
+	// source indexes of items, which data may be accepted by regExp,
+	// or false, if candidates can not be found for regExp
+	typedef std::function<bool(const QRegExp& regExp, QModelIndexList* indexes)> CandidateFinder;
+
+	// matched items of an earlier fixed string filter, the matches of
+	// a filter, which text contains the earlier text, are among them
+	struct Refinement {
+		TextMatcher matcher;
+		QVector<QModelIndex> matches;
+		MatchRanges ranges;
 	};
 
-	typedef QHash<QModelIndex, CacheItem> Cache;
+	// refinements are kept only when no candidates are found, the oldest
+	// ones are dropped, when there are too many of them or of their matches
+	enum { MAX_REFINEMENTS = 8 };
+	enum { MAX_REFINEMENT_MATCHES = 200000 };
+
+	// compares source items, which are sorted by display role,
+	// negative, if left is less than right
+	typedef std::function<int(const QModelIndex& left, const QModelIndex& right)> Comparator;
 
 public:
 	SortFilterProxyModel(QObject* source);
 
 public:
+	void setSourceModel(QAbstractItemModel* sourceModel) Q_DECL_OVERRIDE;
+
+	QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
 	bool setData(
 		const QModelIndex &index,
 		const QVariant &value,
 		int role = Qt::EditRole
 	) Q_DECL_OVERRIDE;
-	
-	QSet<QModelIndex> indexesExpand() const;
+
+	QModelIndexList indexesExpand() const;
+
+	void setCandidateFinder(const CandidateFinder& finder);
+
+	void setComparator(const Comparator& comparator);
+
+	// ranked mode: only matches of a ranked search with their ancestors
+	// and descendants are accepted, text is used as the filter string
+	void setRankedFilter(const QString& text, const QModelIndexList& matches);
+	void clearRankedFilter();
+
+	bool isRanked() const {
+		return isRanked_;
+	}
 
 protected:
 	virtual bool filterAcceptsRow(
-		int sourceRow, 
+		int sourceRow,
 		const QModelIndex &sourceParent
 	) const Q_DECL_OVERRIDE;
 
+	bool lessThan(
+		const QModelIndex& sourceLeft,
+		const QModelIndex& sourceRight
+	) const Q_DECL_OVERRIDE;
+
 private slots:
 	void clearCache() const;
+	void sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+	void sourceRowsInserted(const QModelIndex& parent, int first, int last);
+	void sourceRowsAboutToBeRemoved(const QModelIndex& parent, int first, int last);
+	void sourceLayoutChanged(
+		const QList<QPersistentModelIndex>& parents,
+		QAbstractItemModel::LayoutChangeHint hint
+	);
 
 private:
-	void updateCache() const;
-	CacheItem& cachedAccept(const QModelIndex& sourceIndex, bool* inCache = nullptr) const;
+	bool updateCache() const;
+	bool isFiltered() const;
+	bool acceptsData(const QVariant& data, MatchRange* range = nullptr) const;
+	bool matchIndex(const QModelIndex& sourceIndex) const;
+	CacheItem cacheItem(const QModelIndex& sourceIndex) const;
+	void setCacheItem(const QModelIndex& sourceIndex, const CacheItem& item) const;
+	bool isAncestorMatch(const QModelIndex& sourceParent) const;
+	bool build(const QModelIndex& sourceIndex, bool isAncestorMatch,
+		QVector<QModelIndex>* matches = nullptr) const;
+	bool buildFromCandidates(QVector<QModelIndex>* matches) const;
+	bool buildFromRefinement(QVector<QModelIndex>* matches) const;
+	void buildFromMatches(QVector<QModelIndex>* matches) const;
+	void pushRefinement(const QVector<QModelIndex>& matches) const;
+	int removeTree(const QModelIndex& sourceIndex);
+	void updateMatchedChildren(const QModelIndex& sourceIndex, int delta);
+	void updateAncestorMatch(const QModelIndex& sourceIndex, bool isAncestorMatch);
+	void scheduleInvalidate();
 
 private:
 	mutable Cache cache_;
+	mutable MatchRanges matchRanges_;
 	mutable QRegExp regExpCache_;
-	mutable QAbstractItemModel* sourceModelCache_;
+	CandidateFinder candidateFinder_;
+	Comparator comparator_;
+	mutable TextMatcher matcher_;
+	mutable bool isMatcherUsed_;
+	mutable QVector<Refinement> refinements_;
+	mutable QVector<QModelIndex> expandIndexes_;
+	mutable bool isExpandValid_;
+	QVector<QPersistentModelIndex> rankedMatches_;
+	bool isRanked_;
+	bool isInvalidateScheduled_;
 };
 
+Q_DECLARE_METATYPE(SortFilterProxyModel::MatchRange)
+
 #endif // SORTFILTERPROXYMODEL_H
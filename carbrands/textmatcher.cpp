@@ -0,0 +1,262 @@
+#include "textmatcher.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TEXTMATCHER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(TEXTMATCHER_SSE2) && (defined(_MSC_VER) || defined(__GNUC__))
+#define TEXTMATCHER_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define TEXTMATCHER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TEXTMATCHER_TARGET_AVX2
+#endif
+
+// fold of one code point, that starts at data[i], i is moved to the next one
+inline uint foldAt(const ushort* data, int size, int& i) {
+	uint unit = data[i++];
+	if (unit < 0x80) {
+		return (unit >= 'A' && unit <= 'Z') ? unit + ('a' - 'A') : unit;
+	}
+
+	if (QChar::isHighSurrogate(unit) && i < size && QChar::isLowSurrogate(data[i])) {
+		unit = QChar::surrogateToUcs4(ushort(unit), data[i++]);
+	}
+	return QChar::toCaseFolded(unit);
+}
+
+// units, which fold to a code point other than themselves, by that code point,
+// the table is made once, as it takes a pass over all units
+const QHash<uint, QVector<ushort>>& unfoldedUnits() {
+	static const QHash<uint, QVector<ushort>> units = []() {
+		QHash<uint, QVector<ushort>> units;
+		for (uint unit = 0; unit <= 0xffff; ++unit) {
+			auto folded = QChar::toCaseFolded(unit);
+			if (!QChar::isSurrogate(unit) && folded != unit) {
+				units[folded].push_back(ushort(unit));
+			}
+		}
+		return units;
+	}();
+	return units;
+}
+
+inline int countTrailingZeros(quint32 mask) {
+#if defined(_MSC_VER)
+	unsigned long index = 0;
+	_BitScanForward(&index, mask);
+	return int(index);
+#elif defined(__GNUC__)
+	return __builtin_ctz(mask);
+#else
+	int count = 0;
+	for (; !(mask & 1); mask >>= 1) {
+		++count;
+	}
+	return count;
+#endif
+}
+
+// mask of movemask_epi8 has two bits per unit,
+// returns the first unit, which matches, or -1
+inline int checkCandidates(const TextMatcher& matcher, const ushort* data, int size, int pos, quint32 mask) {
+	while (mask) {
+		auto unit = countTrailingZeros(mask) / 2;
+		mask &= ~(quint32(3) << (unit * 2));
+		if (matcher.matchesAt(data, size, pos + unit)) {
+			return pos + unit;
+		}
+	}
+	return -1;
+}
+
+#ifdef TEXTMATCHER_AVX2
+bool hasAvx2() {
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+
+	__cpuid(info, 1);
+	const int OSXSAVE = 1 << 27;
+	const int AVX = 1 << 28;
+	if ((info[2] & OSXSAVE) == 0 || (info[2] & AVX) == 0 || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// blocks of 16 units, returns the number of checked units
+TEXTMATCHER_TARGET_AVX2
+int findAvx2(const TextMatcher& matcher, const ushort* data, int size,
+	const ushort* units, int count, int* found) {
+	__m256i first[TextMatcher::MAX_FIRST_UNITS];
+	for (int k = 0; k < count; ++k) {
+		first[k] = _mm256_set1_epi16(short(units[k]));
+	}
+
+	int i = 0;
+	for (; i + 16 <= size; i += 16) {
+		auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+		auto equal = _mm256_cmpeq_epi16(block, first[0]);
+		for (int k = 1; k < count; ++k) {
+			equal = _mm256_or_si256(equal, _mm256_cmpeq_epi16(block, first[k]));
+		}
+
+		auto mask = quint32(_mm256_movemask_epi8(equal));
+		if (mask && (*found = checkCandidates(matcher, data, size, i, mask)) != -1) {
+			return i;
+		}
+	}
+	return i;
+}
+#endif
+
+#ifdef TEXTMATCHER_SSE2
+// blocks of 8 units, returns the number of checked units
+int findSse2(const TextMatcher& matcher, const ushort* data, int size,
+	const ushort* units, int count, int* found) {
+	__m128i first[TextMatcher::MAX_FIRST_UNITS];
+	for (int k = 0; k < count; ++k) {
+		first[k] = _mm_set1_epi16(short(units[k]));
+	}
+
+	int i = 0;
+	for (; i + 8 <= size; i += 8) {
+		auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		auto equal = _mm_cmpeq_epi16(block, first[0]);
+		for (int k = 1; k < count; ++k) {
+			equal = _mm_or_si128(equal, _mm_cmpeq_epi16(block, first[k]));
+		}
+
+		auto mask = quint32(_mm_movemask_epi8(equal));
+		if (mask && (*found = checkCandidates(matcher, data, size, i, mask)) != -1) {
+			return i;
+		}
+	}
+	return i;
+}
+#endif
+
+TextMatcher::TextMatcher(const QString& text)
+	: text_(text),
+	folded_(fold(text)),
+	firstUnitCount_(0)
+{
+
+	if (folded_.isEmpty() || folded_.front() > 0xffff) {
+		return;
+	}
+
+	// units, which fold to the first code point, are few: e.g. "k", "K" and kelvin sign
+	auto first = folded_.front();
+	auto& unfolded = unfoldedUnits();
+	auto it = unfolded.find(first);
+	auto count = 1 + ((it != unfolded.end()) ? it.value().size() : 0);
+	if (count > MAX_FIRST_UNITS) {
+		return;
+	}
+
+	firstUnits_[firstUnitCount_++] = ushort(first);
+	if (it != unfolded.end()) {
+		for (auto unit : it.value()) {
+			firstUnits_[firstUnitCount_++] = unit;
+		}
+	}
+}
+
+int TextMatcher::indexOf(const QChar* chars, int size, int* length) const {
+	auto data = reinterpret_cast<const ushort*>(chars);
+	auto position = find(data, size);
+	if (length) {
+		*length = (position != -1) ? matchEnd(data, size, position) - position : 0;
+	}
+	return position;
+}
+
+int TextMatcher::find(const ushort* data, int size) const {
+	if (folded_.isEmpty()) {
+		return 0;
+	}
+
+	if (firstUnitCount_ == 0) {
+		for (int i = 0; i < size; ++i) {
+			if (matchesAt(data, size, i)) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	int i = 0;
+	int found = -1;
+#ifdef TEXTMATCHER_AVX2
+	static const bool isAvx2 = hasAvx2();
+	if (isAvx2) {
+		i = findAvx2(*this, data, size, firstUnits_, firstUnitCount_, &found);
+	}
+#endif
+#ifdef TEXTMATCHER_SSE2
+	if (found == -1) {
+		auto offset = i;
+		i += findSse2(*this, data + offset, size - offset, firstUnits_, firstUnitCount_, &found);
+		if (found != -1) {
+			found += offset;
+		}
+	}
+#endif
+	if (found != -1) {
+		return found;
+	}
+
+	for (; i < size; ++i) {
+		for (int k = 0; k < firstUnitCount_; ++k) {
+			if (data[i] == firstUnits_[k] && matchesAt(data, size, i)) {
+				return i;
+			}
+		}
+	}
+	return -1;
+}
+
+int TextMatcher::matchEnd(const ushort* data, int size, int pos) const {
+	for (auto code : folded_) {
+		if (pos >= size || foldAt(data, size, pos) != code) {
+			return -1;
+		}
+	}
+	return pos;
+}
+
+QVector<uint> TextMatcher::fold(const QString& text) {
+	QVector<uint> folded;
+	auto data = reinterpret_cast<const ushort*>(text.constData());
+	for (int i = 0; i < text.size();) {
+		folded.push_back(foldAt(data, text.size(), i));
+	}
+	return folded;
+}
+
+bool TextMatcher::isBlank(const QChar* data, int size) {
+	for (int i = 0; i < size; ++i) {
+		if (!data[i].isSpace()) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,63 @@
+#ifndef TEXTMATCHER_H
+#define TEXTMATCHER_H
+
+#include <QtCore>
+
+// Case insensitive search of fixed text in UTF-16 data.
+// Text and data are compared by case folded code points, as
+// QString::contains(text, Qt::CaseInsensitive) does, without allocations.
+// Positions of the first code point are found by SSE2 or AVX2 kernels
+// among the units, which fold to it, other positions are not checked.
+class TextMatcher
+{
+public:
+	enum { MAX_FIRST_UNITS = 4 };
+
+public:
+	explicit TextMatcher(const QString& text = QString());
+
+	const QString& text() const {
+		return text_;
+	}
+
+	bool contains(const QChar* data, int size) const {
+		return indexOf(data, size) != -1;
+	}
+
+	bool contains(const QString& data) const {
+		return contains(data.constData(), data.size());
+	}
+
+	// position of the first match in data or -1,
+	// length is the number of units of data in the match
+	int indexOf(const QChar* data, int size, int* length = nullptr) const;
+
+	int indexOf(const QString& data, int* length = nullptr) const {
+		return indexOf(data.constData(), data.size(), length);
+	}
+
+	// true, if text matches data at pos
+	bool matchesAt(const ushort* data, int size, int pos) const {
+		return matchEnd(data, size, pos) != -1;
+	}
+
+	// true, if data is empty or contains only white space
+	static bool isBlank(const QChar* data, int size);
+
+	// case folded code points of text, as text and data are compared
+	static QVector<uint> fold(const QString& text);
+
+private:
+	int find(const ushort* data, int size) const;
+
+	// end of the match at pos or -1
+	int matchEnd(const ushort* data, int size, int pos) const;
+
+private:
+	QString text_;
+	QVector<uint> folded_;
+	ushort firstUnits_[MAX_FIRST_UNITS];
+	int firstUnitCount_;
+};
+
+#endif // TEXTMATCHER_H
@@ -3,107 +3,245 @@
 
 #include <QtCore>
 
+#include "chunkedlist.h"
+#include "labeltable.h"
+#include "objectpool.h"
+
+class TreeItem;
+class TreeStorage;
+
+// children of item, created when the item gets the first child
+struct TreeItemChildren {
+	QHash<const Label*, TreeItem*> unique;
+	ChunkedList<TreeItem> items;
+};
+
 class TreeItem
 {
 public:
 	explicit TreeItem(TreeItem* parent = 0)
-		: unique_(), children_(), data_(), parent_(parent) {}
-
-    ~TreeItem() {
-		qDeleteAll(children_);
-	}
+		: children_(), label_(nullptr), parent_(parent), position_(), pendingNode_(-1) {}
 
-	TreeItem* child(int row) {
-		return children_.value(row, nullptr);
+	TreeItem* child(int row) const {
+		return (children_) ? children_->items.value(row) : nullptr;
 	}
 
 	int childCount() const {
-		return children_.size();
+		return (children_) ? children_->items.size() : 0;
 	}
 
 	const QString& data() const {
-		return data_;
+		return label_->text;
 	}
 
-	bool setData(const QString& data) {
-		if (data == data_) {
-			return false;
-		}
-
-		if (parent_) {
-			if (parent_->unique_.contains(data)) {
-				return false;
-			}
-
-			auto it = parent_->unique_.find(data_);
-			if (it == unique_.end()) {
-				return false;
-			}
-				
-			auto index = *it;
-			parent_->unique_.erase(it);
-			parent_->unique_.insert(data, index);
-		}
-		
-		data_ = data;
-
-		return true;
+	const Label* label() const {
+		return label_;
 	}
 
-	void removeChildren(int position, int count) {
-		for (int i = position + count; i < children_.size(); ++i) {
-			unique_[children_[i]->data()] = i - count;
-		}
+	bool setData(TreeStorage& storage, const QString& data);
 
-		for(int row = 0; row < count; ++row) {
-			QScopedPointer<TreeItem> item(children_.takeAt(position));
-			unique_.remove(item->data());
-		}
-	}
+	void removeChildren(TreeStorage& storage, int position, int count);
 
-	bool insertChildren(const QString& data, int pos = -1) {
-		if (unique_.contains(data)) {
-			return false;
-		}
-		
-		if (pos < 0 || pos >= children_.size()) {
-			pos = children_.size();
-		}
+	bool insertChildren(TreeStorage& storage, const QString& data, int pos = -1);
 
-		unique_[data] = pos;
-		for (int i = pos; i < children_.size(); ++i) {
-			unique_[children_[i]->data_] = i + 1;
-		}
+	bool insertChildren(TreeStorage& storage, const Label* label, int pos = -1);
 
-		QScopedPointer<TreeItem> item(new TreeItem(this));
-		item->data_ = data;
-		children_.insert(pos, item.data());
-		item.take();
+	// true, if children of item "from" can be moved to this item
+	bool canTakeChildren(const TreeItem* from) const;
 
-		return true;
-	}
+	// move all children of item "from" to this item at pos
+	void takeChildren(TreeItem* from, int pos = -1);
 
 	TreeItem* parent() const {
 		return parent_;
 	}
 
+	// row is kept by the parent's child list, so no hash lookup is needed
 	int row() const {
-		return (parent_) ? parent_->index(data_) : 0;
+		return ChunkedList<TreeItem>::row(position_);
 	}
 
 	bool isEmpty() const {
-		return data_.isEmpty();
+		return label_->text.isEmpty();
 	}
 
-	int index(const QString& data, int defaultIndex = -1) const {
-		return unique_.value(data, defaultIndex);
+	// snapshot node, which children are not loaded yet, or -1
+	int pendingNode() const {
+		return pendingNode_;
+	}
+
+	void setPendingNode(int node) {
+		pendingNode_ = node;
+	}
+
+	int index(const Label* label, int defaultIndex = -1) const {
+		auto item = (children_ && label) ? children_->unique.value(label, nullptr) : nullptr;
+		return (item) ? item->row() : defaultIndex;
 	}
 
 private:
-	QHash<QString, int> unique_;
-	QList<TreeItem*> children_;
-    QString data_;
+	friend class ChunkedList<TreeItem>;
+	friend class TreeStorage;
+
+	QScopedPointer<TreeItemChildren> children_;
+	const Label* label_;
     TreeItem* parent_;
+	ChunkedList<TreeItem>::Position position_;
+	int pendingNode_;
 };
 
+// Items of one model, allocated from a pool, and their interned labels.
+// Child items are not deleted by their parent: a removed subtree is
+// returned to the pool by destroy(), and the whole tree is released in
+// one pass when the storage is destroyed.
+class TreeStorage
+{
+public:
+	TreeItem* create(TreeItem* parent = nullptr, const QString& data = QString()) {
+		auto item = items_.create(parent);
+		item->label_ = labels_.acquire(data);
+		return item;
+	}
+
+	TreeItem* create(TreeItem* parent, const Label* label) {
+		auto item = items_.create(parent);
+		item->label_ = labels_.acquire(label);
+		return item;
+	}
+
+	// subtree is walked by an explicit stack, so its depth is not limited by the call stack
+	void destroy(TreeItem* item) {
+		QVector<TreeItem*> items(1, item);
+		while (!items.isEmpty()) {
+			auto current = items.takeLast();
+			if (current->children_) {
+				current->children_->items.forEach([&items](TreeItem* child) { items.push_back(child); });
+			}
+			labels_.release(current->label_);
+			items_.destroy(current);
+		}
+	}
+
+	// interned label or nullptr, if no item has this data
+	const Label* label(const QString& data) const {
+		return labels_.find(data);
+	}
+
+	LabelTable& labels() {
+		return labels_;
+	}
+
+	const LabelTable& labels() const {
+		return labels_;
+	}
+
+	int size() const {
+		return items_.size();
+	}
+
+private:
+	LabelTable labels_;
+	ObjectPool<TreeItem> items_;
+};
+
+inline bool TreeItem::setData(TreeStorage& storage, const QString& data) {
+	if (data == label_->text) {
+		return false;
+	}
+
+	if (parent_ && parent_->index(storage.label(data)) != -1) {
+		return false;
+	}
+
+	auto label = storage.labels().acquire(data);
+	if (parent_) {
+		auto& unique = parent_->children_->unique;
+		unique.remove(label_);
+		unique.insert(label, this);
+	}
+
+	storage.labels().release(label_);
+	label_ = label;
+
+	return true;
+}
+
+inline void TreeItem::removeChildren(TreeStorage& storage, int position, int count) {
+	for(int row = 0; row < count; ++row) {
+		auto item = children_->items.take(position);
+		children_->unique.remove(item->label_);
+		storage.destroy(item);
+	}
+
+	if (children_->items.isEmpty()) {
+		children_.reset();
+	}
+}
+
+inline bool TreeItem::insertChildren(TreeStorage& storage, const QString& data, int pos) {
+	if (index(storage.label(data)) != -1) {
+		return false;
+	}
+
+	auto label = storage.labels().acquire(data);
+	auto isInserted = insertChildren(storage, label, pos);
+	storage.labels().release(label);
+
+	return isInserted;
+}
+
+inline bool TreeItem::insertChildren(TreeStorage& storage, const Label* label, int pos) {
+	if (index(label) != -1) {
+		return false;
+	}
+
+	if (!children_) {
+		children_.reset(new TreeItemChildren());
+	}
+
+	auto& items = children_->items;
+	if (pos < 0 || pos >= items.size()) {
+		pos = items.size();
+	}
+
+	auto item = storage.create(this, label);
+	items.insert(pos, item);
+	children_->unique.insert(item->label_, item);
+
+	return true;
+}
+
+inline bool TreeItem::canTakeChildren(const TreeItem* from) const {
+	bool unique = true;
+	if (children_ && from->children_) {
+		from->children_->items.forEach([this, &unique](const TreeItem* item) {
+			unique = unique && index(item->label_) == -1;
+		});
+	}
+	return unique;
+}
+
+inline void TreeItem::takeChildren(TreeItem* from, int pos) {
+	if (!from->children_) {
+		return;
+	}
+
+	if (!children_) {
+		children_.reset(new TreeItemChildren());
+	}
+
+	auto items = from->children_->items.takeAll();
+	from->children_.reset();
+
+	for (auto item : items) {
+		item->parent_ = this;
+		children_->unique.insert(item->label_, item);
+	}
+
+	if (pos < 0 || pos > children_->items.size()) {
+		pos = children_->items.size();
+	}
+	children_->items.insert(pos, items);
+}
+
 #endif
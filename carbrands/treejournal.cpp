@@ -0,0 +1,350 @@
+#include "treejournal.h"
+#include <algorithm>
+
+#if defined(Q_OS_WIN)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+enum { STREAM_VERSION = QDataStream::Qt_5_0 };
+
+// rows from the top level item down to index
+QVector<qint32> path(QModelIndex index) {
+	QVector<qint32> rows;
+	for (; index.isValid(); index = index.parent()) {
+		rows.push_back(index.row());
+	}
+	std::reverse(rows.begin(), rows.end());
+	return rows;
+}
+
+// record starts with its sequence, operation and path of the changed item
+void writeHeader(QDataStream& out, quint64 sequence, int operation, const QModelIndex& index) {
+	out.setVersion(STREAM_VERSION);
+	out << sequence << quint8(operation) << path(index);
+}
+
+// file starts with the sequence of snapshot, which the records continue
+QByteArray journalHeader(quint64 sequence) {
+	QByteArray header;
+	QDataStream out(&header, QIODevice::WriteOnly);
+	out.setVersion(STREAM_VERSION);
+	out << quint32(TreeJournal::MAGIC) << quint32(TreeJournal::VERSION) << sequence;
+	return header;
+}
+
+// data of file is written to disk, not only to the system cache
+bool syncFile(QFile& file) {
+#if defined(Q_OS_WIN)
+	return _commit(file.handle()) == 0;
+#else
+	return fsync(file.handle()) == 0;
+#endif
+}
+
+TreeJournal::TreeJournal(TreeModel* model, QObject* parent)
+	: QObject(parent),
+	model_(model),
+	file_(),
+	sequence_(0),
+	markSequence_(0),
+	markPosition_(-1),
+	isSyncScheduled_(false) {}
+
+TreeJournal::~TreeJournal() {
+	sync();
+}
+
+QString TreeJournal::rejectedFileName(const QString& fileName) {
+	return fileName + ".rejected";
+}
+
+bool TreeJournal::open(const QString& fileName, quint64 sequence) {
+	file_.setFileName(fileName);
+	if (!file_.open(QFile::ReadWrite)) {
+		qWarning() << "can not open file " << fileName;
+		return false;
+	}
+
+	sequence_ = sequence;
+
+	QDataStream in(&file_);
+	in.setVersion(STREAM_VERSION);
+
+	quint32 magic = 0;
+	quint32 version = 0;
+	quint64 baseSequence = 0;
+	in >> magic >> version >> baseSequence;
+
+	auto isValidHeader = in.status() == QDataStream::Ok
+		&& magic == MAGIC && version == VERSION;
+	if (file_.size() == 0) {
+		if (file_.write(journalHeader(sequence)) < 0 || !sync()) {
+			qWarning() << "can not write journal " << fileName;
+			return false;
+		}
+	}
+	else if (!isValidHeader || baseSequence > sequence) {
+		// records after a newer snapshot can not be replayed on this one
+		qWarning() << "journal does not match snapshot, it is moved to " << rejectedFileName(fileName);
+		if (!reject(0)) {
+			return false;
+		}
+	}
+	else {
+		auto end = file_.pos();
+		while (!in.atEnd()) {
+			QByteArray record;
+			quint16 checksum = 0;
+			in >> record >> checksum;
+			if (in.status() != QDataStream::Ok
+				|| checksum != qChecksum(record.constData(), uint(record.size()))) {
+				qWarning() << "journal is damaged, the rest of it is moved to " << rejectedFileName(fileName);
+				break;
+			}
+
+			if (!replay(record)) {
+				qWarning() << "journal does not match tree, the rest of it is moved to " << rejectedFileName(fileName);
+				break;
+			}
+
+			end = file_.pos();
+		}
+
+		if (end < file_.size() && !reject(end)) {
+			return false;
+		}
+	}
+
+	// new records are appended after the last valid one
+	file_.seek(file_.size());
+
+	connect(model_, &TreeModel::rowsInserted, this, &TreeJournal::rowsInserted);
+	connect(model_, &TreeModel::rowsRemoved, this, &TreeJournal::rowsRemoved);
+	connect(model_, &TreeModel::dataChanged, this, &TreeJournal::dataChanged);
+
+	return true;
+}
+
+// the journal is kept intact in the rejected file, the new journal starts
+// with its first keptSize bytes or, if there are none, with a new header
+bool TreeJournal::reject(qint64 keptSize) {
+	file_.seek(0);
+	auto kept = (keptSize > 0) ? file_.read(keptSize) : journalHeader(sequence_);
+	file_.close();
+
+	auto rejected = rejectedFileName(file_.fileName());
+	QFile::remove(rejected);
+	if (!QFile::rename(file_.fileName(), rejected)) {
+		qWarning() << "can not move journal to " << rejected;
+		return false;
+	}
+
+	if (!file_.open(QFile::ReadWrite) || file_.write(kept) != kept.size() || !sync()) {
+		qWarning() << "can not write journal " << file_.fileName();
+		return false;
+	}
+	return true;
+}
+
+bool TreeJournal::reopen() {
+	if (!file_.open(QFile::ReadWrite)) {
+		qWarning() << "can not open file " << file_.fileName();
+		return false;
+	}
+
+	file_.seek(file_.size());
+	return true;
+}
+
+// compaction
+///////////////////////////////////////////////////////////////////////////////
+quint64 TreeJournal::mark() {
+	markSequence_ = sequence_;
+	markPosition_ = file_.pos();
+	return markSequence_;
+}
+
+// records after the mark are copied to the new journal, which replaces the old one
+bool TreeJournal::compact() {
+	if (markPosition_ < 0) {
+		return false;
+	}
+
+	file_.flush();
+	file_.seek(markPosition_);
+	auto records = file_.readAll();
+	file_.close();
+	markPosition_ = -1;
+
+	auto header = journalHeader(markSequence_);
+	QSaveFile journal(file_.fileName());
+	auto isWritten = journal.open(QFile::WriteOnly)
+		&& journal.write(header) == header.size()
+		&& journal.write(records) == records.size()
+		&& journal.commit();
+	if (!isWritten) {
+		qWarning() << "can not compact journal " << file_.fileName();
+	}
+
+	auto isOpen = reopen();
+	return isWritten && isOpen && sync();
+}
+
+bool TreeJournal::sync() {
+	isSyncScheduled_ = false;
+	if (!file_.isOpen()) {
+		return false;
+	}
+
+	if (!file_.flush() || !syncFile(file_)) {
+		qWarning() << "can not sync journal " << file_.fileName();
+		return false;
+	}
+	return true;
+}
+
+// replay
+///////////////////////////////////////////////////////////////////////////////
+bool TreeJournal::replay(const QByteArray& record) {
+	QDataStream in(record);
+	in.setVersion(STREAM_VERSION);
+
+	quint64 sequence = 0;
+	quint8 operation = 0;
+	QVector<qint32> path;
+	in >> sequence >> operation >> path;
+	if (in.status() != QDataStream::Ok) {
+		return false;
+	}
+
+	if (sequence <= sequence_) {
+		// already in snapshot
+		return true;
+	}
+
+	QModelIndex index;
+	if (sequence != sequence_ + 1 || !find(path, &index) || !replay(operation, index, in)) {
+		return false;
+	}
+
+	sequence_ = sequence;
+	return true;
+}
+
+bool TreeJournal::replay(int operation, const QModelIndex& index, QDataStream& in) {
+	switch (operation) {
+	case INSERT: {
+		qint32 row = 0;
+		qint32 count = 0;
+		in >> row >> count;
+
+		QVector<TreeModel::Node> nodes;
+		for (int i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+			QString data;
+			qint32 depth = 0;
+			in >> data >> depth;
+			nodes.push_back({ data, depth });
+		}
+
+		return in.status() == QDataStream::Ok && model_->insertSubtree(index, row, nodes);
+	}
+	case REMOVE: {
+		qint32 row = 0;
+		qint32 count = 0;
+		in >> row >> count;
+		return in.status() == QDataStream::Ok && model_->removeRows(row, count, index);
+	}
+	case RENAME: {
+		QString data;
+		in >> data;
+		return in.status() == QDataStream::Ok && index.isValid() && model_->setData(index, data);
+	}
+	}
+
+	return false;
+}
+
+// children of items on the path are fetched, if they are not loaded yet
+bool TreeJournal::find(const QVector<qint32>& path, QModelIndex* index) const {
+	QModelIndex parent;
+	for (auto row : path) {
+		if (model_->canFetchMore(parent)) {
+			model_->fetchMore(parent);
+		}
+
+		if (row < 0 || row >= model_->rowCount(parent)) {
+			return false;
+		}
+		parent = model_->index(row, 0, parent);
+	}
+
+	*index = parent;
+	return true;
+}
+
+// record
+///////////////////////////////////////////////////////////////////////////////
+void TreeJournal::rowsInserted(const QModelIndex& parent, int first, int last) {
+	if (model_->isFetching()) {
+		return;
+	}
+
+	auto nodes = model_->subtree(parent, first, last);
+
+	QByteArray record;
+	QDataStream out(&record, QIODevice::WriteOnly);
+	writeHeader(out, sequence_ + 1, INSERT, parent);
+	out << qint32(first) << qint32(nodes.size());
+	for (auto& node : nodes) {
+		out << node.data << qint32(node.depth);
+	}
+
+	append(record);
+}
+
+void TreeJournal::rowsRemoved(const QModelIndex& parent, int first, int last) {
+	QByteArray record;
+	QDataStream out(&record, QIODevice::WriteOnly);
+	writeHeader(out, sequence_ + 1, REMOVE, parent);
+	out << qint32(first) << qint32(last - first + 1);
+
+	append(record);
+}
+
+void TreeJournal::dataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight) {
+	for (int row = topLeft.row(); row <= bottomRight.row(); ++row) {
+		auto index = topLeft.sibling(row, 0);
+
+		QByteArray record;
+		QDataStream out(&record, QIODevice::WriteOnly);
+		writeHeader(out, sequence_ + 1, RENAME, index);
+		out << model_->item(index)->data();
+
+		append(record);
+	}
+}
+
+// record is written with its checksum, so a torn write is detected on replay
+void TreeJournal::append(const QByteArray& record) {
+	QDataStream out(&file_);
+	out.setVersion(STREAM_VERSION);
+	out << record << qChecksum(record.constData(), uint(record.size()));
+
+	if (out.status() != QDataStream::Ok || !file_.flush()) {
+		qWarning() << "can not write journal " << file_.fileName();
+	}
+
+	++sequence_;
+
+	// records of one change, e.g. a drop, are synced together
+	if (!isSyncScheduled_) {
+		isSyncScheduled_ = true;
+		QTimer::singleShot(0, this, [this]() {
+			if (isSyncScheduled_) {
+				sync();
+			}
+		});
+	}
+}
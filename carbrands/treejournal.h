@@ -0,0 +1,80 @@
+#ifndef TREEJOURNAL_H
+#define TREEJOURNAL_H
+
+#include <QtCore>
+
+#include "treemodel.h"
+
+// Append-only journal of model changes.
+// The file starts with the sequence of the snapshot, which the journal
+// continues. Each record is an operation addressed by the row path of its
+// parent, numbered by the sequence. Records, which are already in the
+// snapshot, are skipped by replay. A journal, which does not match the
+// snapshot or the tree, is moved intact to the rejected file, and a new
+// journal keeps the records replayed before the mismatch.
+// Records are flushed when they are appended and synced to disk once
+// per batch of changes.
+class TreeJournal : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Operation { INSERT = 1, REMOVE, RENAME };
+	enum { MAGIC = 0x4a544243, VERSION = 1 };
+
+public:
+	explicit TreeJournal(TreeModel* model, QObject* parent = 0);
+	~TreeJournal();
+
+	// replay records after sequence of snapshot and record further changes of model
+	bool open(const QString& fileName, quint64 sequence);
+
+	// sequence of the last record
+	quint64 sequence() const {
+		return sequence_;
+	}
+
+	qint64 size() const {
+		return file_.size();
+	}
+
+	// records up to the current one are being saved to a snapshot,
+	// returns their last sequence
+	quint64 mark();
+
+	// drop the records up to the mark, when they are saved to snapshot
+	bool compact();
+
+	// write appended records to disk
+	bool sync();
+
+	static QString rejectedFileName(const QString& fileName);
+
+private slots:
+	void rowsInserted(const QModelIndex& parent, int first, int last);
+	void rowsRemoved(const QModelIndex& parent, int first, int last);
+	void dataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight);
+
+private:
+	bool replay(const QByteArray& record);
+
+	bool replay(int operation, const QModelIndex& index, QDataStream& in);
+
+	bool find(const QVector<qint32>& path, QModelIndex* index) const;
+
+	void append(const QByteArray& record);
+
+	bool reject(qint64 keptSize);
+
+	bool reopen();
+
+private:
+	TreeModel* model_;
+	QFile file_;
+	quint64 sequence_;
+	quint64 markSequence_;
+	qint64 markPosition_;
+	bool isSyncScheduled_;
+};
+
+#endif // TREEJOURNAL_H
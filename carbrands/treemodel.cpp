@@ -1,12 +1,34 @@
 #include "treemodel.h"
-#include <QtXml>
+#include <QtCore>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
 
 TreeModel::TreeModel(QObject* parent)
     : QAbstractItemModel(parent), 
-	 root_(new TreeItem()) {}
+	 storage_(),
+	 root_(storage_.create()),
+	 snapshotFile_(),
+	 snapshot_(),
+	 pending_(),
+	 snapshotIndex_(),
+	 snapshotIndexBuild_(),
+	 fetching_(false),
+	 searchIndex_(),
+	 changeCount_(0)
+{
+	// tables being built read the items, so any change is counted
+	auto changed = [this]() { ++changeCount_; };
+	connect(this, &QAbstractItemModel::rowsAboutToBeInserted, this, changed);
+	connect(this, &QAbstractItemModel::rowsAboutToBeRemoved, this, changed);
+	connect(this, &QAbstractItemModel::rowsAboutToBeMoved, this, changed);
+	connect(this, &QAbstractItemModel::dataChanged, this, changed);
+	connect(this, &QAbstractItemModel::layoutAboutToBeChanged, this, changed);
+	connect(this, &QAbstractItemModel::modelAboutToBeReset, this, changed);
+}
 
 TreeModel::~TreeModel() {
-    delete root_;
+	snapshotIndexBuild_.waitForFinished();
 }
 
 // set/get data
@@ -26,10 +48,26 @@ bool TreeModel::setData(
 	const QVariant& value, 
 	int role
 ) {
+	InstrumentationTimer timer(Instrumentation::MODEL_SET_DATA);
 	if (role == Qt::EditRole) {
 		auto item = this->item(index);
 		auto data = value.toString().trimmed();
-		if (!data.isEmpty() && item->setData(data)) {
+		if (data.isEmpty()) {
+			return false;
+		}
+
+		auto isIndexed = searchIndex_ && item != root_;
+		if (isIndexed) {
+			searchIndex_->remove(item);
+		}
+
+		auto isChanged = item->setData(storage_, data);
+
+		if (isIndexed) {
+			searchIndex_->insert(item);
+		}
+
+		if (isChanged) {
 			if (item != root_) {
 				emit dataChanged(index, index);
 			}
@@ -79,9 +117,339 @@ int TreeModel::columnCount(const QModelIndex&) const {
 	return 1;
 }
 
+bool TreeModel::hasChildren(const QModelIndex& parent) const {
+	auto parentItem = item(parent);
+	return parentItem->childCount() > 0 || parentItem->pendingNode() != -1;
+}
+
+// lazy loading
+///////////////////////////////////////////////////////////////////////////////////////
+bool TreeModel::canFetchMore(const QModelIndex& parent) const {
+	return item(parent)->pendingNode() != -1;
+}
+
+void TreeModel::fetchMore(const QModelIndex& parent) {
+	auto parentItem = item(parent);
+	auto node = parentItem->pendingNode();
+	if (node == -1) {
+		return;
+	}
+
+	parentItem->setPendingNode(-1);
+	pending_.remove(node);
+
+	auto items = storage_.create();
+	readPending(items, node);
+
+	fetching_ = true;
+	insertChildren(parent, 0, items);
+	fetching_ = false;
+}
+
+void TreeModel::fetch(const QModelIndex& parent) {
+	if (canFetchMore(parent)) {
+		fetchMore(parent);
+	}
+}
+
+// read children of snapshot node, their children are left pending
+void TreeModel::readPending(TreeItem* items, int node) {
+	if (snapshotIndex_) {
+		snapshotIndex_->setFetched(node);
+	}
+	readPending(snapshot_, items, node, &pending_);
+}
+
+void TreeModel::readPending(const SnapshotView& snapshot, TreeItem* items, int node, QHash<int, TreeItem*>* pending) {
+	auto& parentNode = snapshot.node(node);
+	for (int i = 0; i < parentNode.childCount; ++i) {
+		auto childNode = parentNode.firstChild + i;
+		auto row = items->childCount();
+		if (items->insertChildren(storage_, snapshot.data(childNode), row)
+			&& snapshot.node(childNode).childCount > 0) {
+			auto item = items->child(row);
+			item->setPendingNode(childNode);
+			pending->insert(childNode, item);
+		}
+	}
+}
+
+// subtrees are walked by explicit stacks, so their depth is not limited by the call stack
+void TreeModel::removePending(TreeItem* item) {
+	QVector<TreeItem*> items(1, item);
+	while (!items.isEmpty()) {
+		auto current = items.takeLast();
+		if (current->pendingNode() != -1) {
+			pending_.remove(current->pendingNode());
+		}
+
+		auto childCount = current->childCount();
+		for (int row = 0; row < childCount; ++row) {
+			items.push_back(current->child(row));
+		}
+	}
+}
+
+bool TreeModel::openSnapshot(const QString& fileName) {
+	InstrumentationTimer timer(Instrumentation::SNAPSHOT_READ);
+	QScopedPointer<QFile> file(new QFile(fileName));
+	if (!file->open(QFile::ReadOnly)) {
+		qWarning() << "can not open file " << fileName;
+		return false;
+	}
+
+	auto size = file->size();
+	SnapshotView snapshot;
+	if (!snapshot.open(file->map(0, size), size)) {
+		qWarning() << "invalid snapshot " << fileName;
+		return false;
+	}
+
+	// the top level is checked, while the old snapshot and its pending items are kept
+	auto items = storage_.create();
+	QHash<int, TreeItem*> pending;
+	readPending(snapshot, items, 0, &pending);
+	if (!item(QModelIndex())->canTakeChildren(items)) {
+		qWarning() << "data of snapshot is not unique " << fileName;
+		storage_.destroy(items);
+		return false;
+	}
+
+	for (auto item : pending_) {
+		item->setPendingNode(-1);
+	}
+	pending_.swap(pending);
+
+	// the index of the old snapshot is dropped before its file is unmapped
+	snapshotIndexBuild_.waitForFinished();
+	snapshotIndex_.reset(new SnapshotIndex(snapshot));
+	snapshotIndex_->setFetched(0);
+	snapshotIndexBuild_ = QtConcurrent::run(snapshotIndex_.data(), &SnapshotIndex::build);
+
+	snapshotFile_.swap(file);
+	snapshot_ = snapshot;
+	++changeCount_;
+
+	// only an empty top level is not inserted
+	auto isEmpty = items->childCount() == 0;
+	fetching_ = true;
+	auto isInserted = insertChildren(QModelIndex(), 0, items);
+	fetching_ = false;
+
+	return isInserted || isEmpty;
+}
+
+// short texts fetch less, so a keystroke does not load most of the tree
+TreeModel::Matches TreeModel::findMatches(const QString& text, const SearchToken& token) const {
+	Matches matches;
+	if (searchIndex_) {
+		matches.labels = searchIndex_->findLabels(text, token);
+	}
+
+	if (text.isEmpty() || !snapshotIndex_ || token.isCanceled()) {
+		return matches;
+	}
+
+	auto limit = (text.size() < 3) ? SHORT_FETCH_LIMIT : FETCH_LIMIT;
+	matches.nodes = snapshotIndex_->find(text, limit, token);
+
+	// labels of nodes are known before the nodes are fetched
+	QSet<QString> labels;
+	for (auto node : matches.nodes) {
+		labels.insert(snapshot_.data(node));
+	}
+	for (auto& label : labels) {
+		matches.labels.push_back(label);
+	}
+	return matches;
+}
+
+void TreeModel::fetchNodes(const QVector<int>& nodes) {
+	if (pending_.isEmpty()) {
+		return;
+	}
+
+	for (auto node : nodes) {
+		fetchPath(node);
+	}
+}
+
+// the index is not waited for, labels of a snapshot, which is being indexed, are not fetched
+void TreeModel::fetchLabels(const QVector<QString>& labels) {
+	if (pending_.isEmpty() || !snapshotIndex_ || !snapshotIndexBuild_.isFinished()) {
+		return;
+	}
+
+	auto limit = int(FETCH_LIMIT);
+	for (auto& label : labels) {
+		auto nodes = snapshotIndex_->findExact(label, limit);
+		fetchNodes(nodes);
+
+		limit -= nodes.size();
+		if (limit <= 0) {
+			break;
+		}
+	}
+}
+
+QVector<Label> TreeModel::labelSnapshot() const {
+	return (searchIndex_) ? searchIndex_->labels() : QVector<Label>();
+}
+
+QVector<Label> TreeModel::snapshotLabels() const {
+	if (!snapshotIndex_ || !snapshotIndexBuild_.isFinished()) {
+		return {};
+	}
+	return snapshotIndex_->labels();
+}
+
+// load items from the nearest pending parent down to the snapshot node
+void TreeModel::fetchPath(int node) {
+	QVector<int> path;
+	auto parent = snapshot_.node(node).parent;
+	while (parent > 0 && !pending_.contains(parent)) {
+		path.push_back(parent);
+		parent = snapshot_.node(parent).parent;
+	}
+
+	if (!pending_.contains(parent)) {
+		return;
+	}
+	path.push_back(parent);
+
+	for (int i = path.size() - 1; i >= 0; --i) {
+		auto item = pending_.value(path[i], nullptr);
+		if (!item) {
+			return;
+		}
+		fetchMore(indexOf(item));
+	}
+}
+
+// sort
+///////////////////////////////////////////////////////////////////////////////////////
+int TreeModel::compare(const QModelIndex& left, const QModelIndex& right) const {
+	auto leftLabel = item(left)->label();
+	auto rightLabel = item(right)->label();
+	if (leftLabel == rightLabel) {
+		return 0;
+	}
+
+	auto& labels = storage_.labels();
+	return labels.sortKey(leftLabel).compare(labels.sortKey(rightLabel));
+}
+
+// rows are not moved, but the order by data is changed, so sorted views sort again
+// rows keep their items, only their sorted order is changed
+void TreeModel::setCollator(const QCollator& collator) {
+	emit layoutAboutToBeChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+	storage_.labels().setCollator(collator);
+	emit layoutChanged(QList<QPersistentModelIndex>(), QAbstractItemModel::VerticalSortHint);
+}
+
+// search index
+///////////////////////////////////////////////////////////////////////////////////////
+void TreeModel::setSearchIndexEnabled(bool isEnabled) {
+	if (!isEnabled) {
+		searchIndex_.reset();
+		return;
+	}
+
+	if (!searchIndex_) {
+		searchIndex_.reset(new TrigramIndex<TreeItem>());
+		auto childCount = root_->childCount();
+		for (int row = 0; row < childCount; ++row) {
+			addToSearchIndex(root_->child(row));
+		}
+	}
+}
+
+bool TreeModel::findIndexes(const QString& text, QModelIndexList* indexes) const {
+	if (!searchIndex_) {
+		return false;
+	}
+
+	// empty items are being edited, search shows them
+	auto items = searchIndex_->find(text);
+	auto emptyLabel = storage_.label(QString());
+	if (emptyLabel && !text.isEmpty()) {
+		items += searchIndex_->items(emptyLabel);
+	}
+
+	for (auto item : items) {
+		indexes->push_back(indexOf(item));
+	}
+	return true;
+}
+
+bool TreeModel::findIndexes(const QVector<QString>& labels, QModelIndexList* indexes) const {
+	if (!searchIndex_) {
+		return false;
+	}
+
+	// labels may repeat, e.g. a label of loaded items and of snapshot nodes
+	QSet<const Label*> found;
+	auto emptyLabel = storage_.label(QString());
+	if (emptyLabel) {
+		found.insert(emptyLabel);
+	}
+	for (auto& label : labels) {
+		auto current = storage_.label(label);
+		if (current) {
+			found.insert(current);
+		}
+	}
+
+	QVector<TreeItem*> items;
+	for (auto label : found) {
+		items += searchIndex_->items(label);
+	}
+
+	for (auto item : items) {
+		indexes->push_back(indexOf(item));
+	}
+	return true;
+}
+
+void TreeModel::addToSearchIndex(TreeItem* item) {
+	if (!searchIndex_) {
+		return;
+	}
+
+	QVector<TreeItem*> items(1, item);
+	while (!items.isEmpty()) {
+		auto current = items.takeLast();
+		searchIndex_->insert(current);
+
+		auto childCount = current->childCount();
+		for (int row = 0; row < childCount; ++row) {
+			items.push_back(current->child(row));
+		}
+	}
+}
+
+void TreeModel::removeFromSearchIndex(TreeItem* item) {
+	if (!searchIndex_) {
+		return;
+	}
+
+	QVector<TreeItem*> items(1, item);
+	while (!items.isEmpty()) {
+		auto current = items.takeLast();
+		searchIndex_->remove(current);
+
+		auto childCount = current->childCount();
+		for (int row = 0; row < childCount; ++row) {
+			items.push_back(current->child(row));
+		}
+	}
+}
+
 // insert, remove 
 /////////////////////////////////////////////////////////////////////////////////////////
 QModelIndex TreeModel::insert(const QString& data, int pos, const QModelIndex& parent) {
+	InstrumentationTimer timer(Instrumentation::MODEL_INSERT);
+	fetch(parent);
 	auto parentItem = item(parent);
 
 	if (pos < 0 || pos > parentItem->childCount()) {
@@ -89,18 +457,145 @@ QModelIndex TreeModel::insert(const QString& data, int pos, const QModelIndex& p
 		return{};
 	}
 
-	if (parentItem->index(data) != -1) {
+	if (parentItem->index(storage_.label(data)) != -1) {
 		qWarning() << "data is not unique";
 		return{};
 	}
 
 	beginInsertRows(parent, pos, pos);
-	parentItem->insertChildren(data, pos);
+	parentItem->insertChildren(storage_, data, pos);
+	addToSearchIndex(parentItem->child(pos));
 	endInsertRows();
 
 	return index(pos, 0, parent);
 }
 
+bool TreeModel::insertBatch(const QModelIndex& parent, int pos, const QStringList& data) {
+	QVector<Node> nodes;
+	nodes.reserve(data.size());
+	for (auto& itemData : data) {
+		nodes.push_back({ itemData, 0 });
+	}
+
+	return insertSubtree(parent, pos, nodes);
+}
+
+bool isValidSubtree(
+	const TreeStorage& storage,
+	const TreeItem* parentItem,
+	const QVector<TreeModel::Node>& nodes
+) {
+	if (nodes.isEmpty() || nodes.front().depth != 0) {
+		return false;
+	}
+
+	QVector<QSet<QString>> unique(1);
+	for (auto& node : nodes) {
+		if (node.depth < 0 || node.depth >= unique.size()) {
+			return false;
+		}
+
+		unique.resize(node.depth + 1);
+		auto& siblings = unique.last();
+		if (siblings.contains(node.data)
+			|| (node.depth == 0 && parentItem->index(storage.label(node.data)) != -1)) {
+			return false;
+		}
+
+		siblings.insert(node.data);
+		unique.push_back({});
+	}
+
+	return true;
+}
+
+bool TreeModel::insertSubtree(const QModelIndex& parent, int pos, const QVector<Node>& nodes) {
+	InstrumentationTimer timer(Instrumentation::MODEL_INSERT);
+	fetch(parent);
+	auto parentItem = item(parent);
+
+	if (pos < 0 || pos > parentItem->childCount()) {
+		qWarning() << "invalid argument (position)";
+		return false;
+	}
+
+	if (!isValidSubtree(storage_, parentItem, nodes)) {
+		qWarning() << "invalid subtree or data is not unique";
+		return false;
+	}
+
+	int count = 0;
+	for (auto& node : nodes) {
+		count += (node.depth == 0) ? 1 : 0;
+	}
+
+	beginInsertRows(parent, pos, pos + count - 1);
+
+	QVector<TreeItem*> parents(1, parentItem);
+	for (auto& node : nodes) {
+		parents.resize(node.depth + 1);
+		auto item = parents.last();
+		auto row = (node.depth == 0) ? pos++ : item->childCount();
+		item->insertChildren(storage_, node.data, row);
+		parents.push_back(item->child(row));
+		if (searchIndex_) {
+			searchIndex_->insert(parents.last());
+		}
+	}
+
+	endInsertRows();
+
+	return true;
+}
+
+// item or, if item is null, snapshot node of a walk over a subtree,
+// which children are not loaded yet
+struct SubtreeEntry {
+	const TreeItem* item;
+	int node;
+	int depth;
+};
+
+// children of entry are pushed in reverse, so they are taken in order:
+// the loaded children of item, then the children not loaded from snapshot
+void pushChildren(QVector<SubtreeEntry>& entries, const SnapshotView& snapshot, const SubtreeEntry& entry) {
+	auto node = (entry.item) ? entry.item->pendingNode() : entry.node;
+	if (node != -1) {
+		auto& snapshotNode = snapshot.node(node);
+		for (int i = snapshotNode.childCount - 1; i >= 0; --i) {
+			entries.push_back({ nullptr, snapshotNode.firstChild + i, entry.depth + 1 });
+		}
+	}
+
+	if (entry.item) {
+		for (int row = entry.item->childCount() - 1; row >= 0; --row) {
+			entries.push_back({ entry.item->child(row), -1, entry.depth + 1 });
+		}
+	}
+}
+
+// children not loaded from snapshot are taken from snapshot
+void appendSubtree(QVector<TreeModel::Node>& nodes, const SnapshotView& snapshot, const TreeItem* item) {
+	QVector<SubtreeEntry> entries(1, SubtreeEntry{ item, -1, 0 });
+	while (!entries.isEmpty()) {
+		auto entry = entries.takeLast();
+		nodes.push_back({ (entry.item) ? entry.item->data() : snapshot.data(entry.node), entry.depth });
+		pushChildren(entries, snapshot, entry);
+	}
+}
+
+QVector<TreeModel::Node> TreeModel::subtree(const QModelIndex& parent, int first, int last) const {
+	QVector<Node> nodes;
+	auto parentItem = item(parent);
+	for (int row = first; row <= last; ++row) {
+		auto child = parentItem->child(row);
+		if (child) {
+			appendSubtree(nodes, snapshot_, child);
+		}
+	}
+	return nodes;
+}
+
 bool TreeModel::insertRows(int pos, int count, const QModelIndex &parent) {
 	if (count != 1) {
 		qWarning() << "model support insert only one row, because each item must be unique";
@@ -111,6 +606,7 @@ bool TreeModel::insertRows(int pos, int count, const QModelIndex &parent) {
 }
 
 bool TreeModel::removeRows(int pos, int count, const QModelIndex &parent) {
+	InstrumentationTimer timer(Instrumentation::MODEL_REMOVE);
 	if (pos < 0 || count <= 0) {
 		qWarning() << "invalid arguments";
 		return false;
@@ -124,8 +620,18 @@ bool TreeModel::removeRows(int pos, int count, const QModelIndex &parent) {
 		return false;
 	}
 
+	if (!pending_.isEmpty()) {
+		for (int row = pos; row < pos + count; ++row) {
+			removePending(parentItem->child(row));
+		}
+	}
+
+	for (int row = pos; row < pos + count; ++row) {
+		removeFromSearchIndex(parentItem->child(row));
+	}
+
 	beginRemoveRows(parent, pos, pos + count - 1);
-	parentItem->removeChildren(pos, count);
+	parentItem->removeChildren(storage_, pos, count);
 	endRemoveRows();
 
 	return true;
@@ -221,115 +727,208 @@ bool TreeModel::dropMimeData(
 
 // serialize
 ///////////////////////////////////////////////////////////////////////////////
-QString cdata(const QString& data) {
-	return (data.isEmpty()) ? QString() : QString("<![CDATA[%1]]>").arg(data);
+const QString& itemTag() {
+	static const QString tag(QStringLiteral("item"));
+	return tag;
 }
 
-void serialize(
-	const TreeModel* model, 
-	QTextStream& out, 
-	const QModelIndex &root,
-	bool serializeIndex = false
-) {
-	out << "<item>" << cdata(model->item(root)->data());
-
-	if (serializeIndex) {
-		QVector<QModelIndex> parents;
-		if (root.isValid()) {
-			auto parent = root.parent();
-			while (parent.isValid()) {
-				parents.push_back(parent);
-				parent = parent.parent();
-			}
-		}
-		std::reverse(parents.begin(), parents.end());
-		for (auto parent : parents) {
-			out << "<index>"
-				<< cdata(model->item(parent)->data())
-				<< "</index>";
-		}
+const QString& indexTag() {
+	static const QString tag(QStringLiteral("index"));
+	return tag;
+}
+
+// QXmlStreamWriter splits "]]>" in data to several CDATA sections
+void writeData(QXmlStreamWriter& out, const QString& data) {
+	if (!data.isEmpty()) {
+		out.writeCDATA(data);
 	}
+}
 
-	auto rowCount = model->rowCount(root);
-	for (int row = 0; row < rowCount; ++row) {
-		auto index = model->index(row, 0, root);
-		if (index.isValid()) {
-			serialize(model, out, index);
+// children not loaded from snapshot are written from snapshot,
+// an entry without item and node ends the element of its item
+void serializeChildren(QXmlStreamWriter& out, const SnapshotView& snapshot, const TreeItem* item) {
+	QVector<SubtreeEntry> entries;
+	pushChildren(entries, snapshot, { item, -1, 0 });
+	while (!entries.isEmpty()) {
+		auto entry = entries.takeLast();
+		if (!entry.item && entry.node == -1) {
+			out.writeEndElement();
+			continue;
 		}
-	}
 
-	out << "</item>";
+		out.writeStartElement(itemTag());
+		writeData(out, (entry.item) ? entry.item->data() : snapshot.rawData(entry.node));
+		entries.push_back({ nullptr, -1, entry.depth });
+		pushChildren(entries, snapshot, entry);
+	}
 }
 
-QTextCodec* serializeCodec() {
-	return QTextCodec::codecForName("UTF-8");
+bool TreeModel::serialize(QIODevice* device, const QModelIndex& root) const {
+	InstrumentationTimer timer(Instrumentation::SERIALIZE);
+	QXmlStreamWriter out(device);
+	out.setCodec("UTF-8");
+
+	auto rootItem = item(root);
+	out.writeStartElement(itemTag());
+	writeData(out, rootItem->data());
+
+	QVector<const TreeItem*> parents;
+	for (auto parent = rootItem->parent(); parent && parent != root_; parent = parent->parent()) {
+		parents.push_back(parent);
+	}
+	std::reverse(parents.begin(), parents.end());
+	for (auto parent : parents) {
+		out.writeStartElement(indexTag());
+		writeData(out, parent->data());
+		out.writeEndElement();
+	}
+
+	serializeChildren(out, snapshot_, rootItem);
+
+	out.writeEndElement();
+
+	return !out.hasError();
 }
 
 QByteArray TreeModel::serialize(const QModelIndex& root) const {
 	QByteArray data;
-	QTextStream out(&data);
-	out.setCodec(serializeCodec());
-	::serialize(this, out, root, true);
-	out.flush();
+	QBuffer buffer(&data);
+	buffer.open(QIODevice::WriteOnly);
+	serialize(&buffer, root);
 	return data;
 }
 
 // deserialize
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-QString cdata(const QDomElement& item) {
-	return item.firstChild().toCDATASection().data();
+// next start or end element
+bool readNextElement(QXmlStreamReader& reader) {
+	while (!reader.atEnd()) {
+		reader.readNext();
+		if (reader.isStartElement() || reader.isEndElement()) {
+			return true;
+		}
+	}
+	return false;
 }
 
-void deserialize(TreeModel* model, QDomElement item, const QModelIndex& parent = QModelIndex());
-
-void deserialize(TreeModel* model, const QDomElement& item, int row, const QModelIndex& parent = QModelIndex()) {
-	auto index = model->insert(cdata(item), row, parent);
-	if (index.isValid()) {
-		deserialize(model, item, index);
+// CDATA of current element, reader stops at the first child or at the end of element
+QString readData(QXmlStreamReader& reader) {
+	QString data;
+	while (!reader.atEnd()) {
+		reader.readNext();
+		if (reader.isCDATA()) {
+			data += reader.text();
+		}
+		else if (reader.isStartElement() || reader.isEndElement()) {
+			break;
+		}
 	}
+	return data;
 }
 
-void deserialize(TreeModel* model, QDomElement item, const QModelIndex& parent) {
-	const QString itemTag(QStringLiteral("item"));
-	int row = 0;
-	for (item = item.firstChildElement(itemTag); !item.isNull();
-		item = item.nextSiblingElement(itemTag), ++row) {
-		deserialize(model, item, row, parent);
+// read child items to parentItem, items with duplicate data are skipped,
+// if parentItem is null, all items are skipped; parents of the elements
+// being read are kept in an explicit stack, null for skipped ones
+void readChildren(QXmlStreamReader& reader, TreeStorage& storage, TreeItem* parentItem) {
+	QVector<TreeItem*> parents(1, parentItem);
+	for (;;) {
+		if (reader.isStartElement()) {
+			if (reader.name() == itemTag()) {
+				auto data = readData(reader);
+				auto parent = parents.last();
+				TreeItem* item = nullptr;
+				if (parent) {
+					auto row = parent->childCount();
+					if (parent->insertChildren(storage, data, row)) {
+						item = parent->child(row);
+					}
+				}
+
+				// children of item are read next
+				parents.push_back(item);
+				continue;
+			}
+
+			reader.skipCurrentElement();
+		}
+		else {
+			// end of the children of the last parent
+			if (parents.size() == 1) {
+				return;
+			}
+			parents.pop_back();
+		}
+
+		readNextElement(reader);
 	}
 }
 
-QModelIndex index(const TreeModel* model, const QDomElement& item, QModelIndex index = QModelIndex()) {
-	const QString indexTag(QStringLiteral("index"));
-	for (auto indexItem = item.firstChildElement(indexTag); !indexItem.isNull();
-		indexItem = indexItem.nextSiblingElement(indexTag)) {
-		index = model->index(cdata(indexItem), index);
+// rest of document after the root item, false, if it is not well-formed
+bool readToEnd(QXmlStreamReader& reader) {
+	while (!reader.atEnd()) {
+		reader.readNext();
 	}
-	index = model->index(cdata(item), index);
-	return index;
+	return !reader.hasError();
 }
 
+bool TreeModel::insertChildren(const QModelIndex& parent, int pos, TreeItem* from) {
+	fetch(parent);
+	auto parentItem = item(parent);
 
-bool TreeModel::deserialize(const QByteArray& data, const QModelIndex& indexTo, bool checkOnly) {
-	QDomDocument doc;
+	// rows with data of existing children are skipped one by one, as by insert
+	auto isUnique = true;
+	for (int row = from->childCount() - 1; row >= 0; --row) {
+		auto child = from->child(row);
+		if (parentItem->index(child->label()) != -1) {
+			isUnique = false;
+			removePending(child);
+			from->removeChildren(storage_, row, 1);
+		}
+	}
+	if (!isUnique) {
+		qWarning() << "data is not unique, rows are skipped";
+	}
 
-	QString errorMessage;
-	int errorLine = -1, errorColumn = -1;
-	if (!doc.setContent(serializeCodec()->toUnicode(data), &errorMessage, &errorLine, &errorColumn)) {
-		qWarning()
-			<< "Invalid xml. " << errorMessage
-			<< ", Line:" << errorLine
-			<< ", Column: " << errorColumn;
-		return false;
+	auto count = from->childCount();
+	bool isInserted = false;
+	if (pos < 0 || pos > parentItem->childCount()) {
+		qWarning() << "invalid argument (position)";
+	}
+	else if (count > 0) {
+		beginInsertRows(parent, pos, pos + count - 1);
+		parentItem->takeChildren(from, pos);
+		for (int row = pos; row < pos + count; ++row) {
+			addToSearchIndex(parentItem->child(row));
+		}
+		endInsertRows();
+		isInserted = true;
 	}
 
-	auto item = doc.documentElement();
+	storage_.destroy(from);
+	return isInserted;
+}
 
-	if (item.isNull()) {
-		qWarning() << "Invalid xml";
+bool TreeModel::deserialize(QXmlStreamReader& reader, const QModelIndex& indexTo, bool checkOnly) {
+	InstrumentationTimer parseTimer(Instrumentation::DESERIALIZE_PARSE);
+	if (!reader.readNextStartElement() || reader.name() != itemTag()) {
+		qWarning()
+			<< "Invalid xml. " << reader.errorString()
+			<< ", Line:" << reader.lineNumber()
+			<< ", Column: " << reader.columnNumber();
 		return false;
 	}
 
-	auto indexFrom = ::index(this, item);
+	auto data = readData(reader);
+
+	QModelIndex indexFrom;
+	bool isValidPath = true;
+	while (reader.isStartElement() && reader.name() == indexTag()) {
+		auto index = this->index(readData(reader), indexFrom);
+		isValidPath = isValidPath && index.isValid();
+		indexFrom = index;
+		readNextElement(reader);
+	}
+	indexFrom = (isValidPath) ? index(data, indexFrom) : QModelIndex();
 
 	bool isValidTo = indexTo.isValid();
 	int row = 0;
@@ -346,21 +945,221 @@ bool TreeModel::deserialize(const QByteArray& data, const QModelIndex& indexTo,
 		}
 	}
 
+	// a check parses the whole payload as the drop does, but keeps no items
 	if (checkOnly) {
-		return true;
+		readChildren(reader, storage_, nullptr);
+		return readToEnd(reader);
+	}
+
+	auto items = storage_.create();
+	if (isValidTo) {
+		items->insertChildren(storage_, data);
+		readChildren(reader, storage_, items->child(0));
+	}
+	else {
+		readChildren(reader, storage_, items);
 	}
 
+	if (!readToEnd(reader)) {
+		qWarning()
+			<< "Invalid xml. " << reader.errorString()
+			<< ", Line:" << reader.lineNumber()
+			<< ", Column: " << reader.columnNumber();
+		storage_.destroy(items);
+		return false;
+	}
+
+	parseTimer.stop();
+	InstrumentationTimer insertTimer(Instrumentation::DESERIALIZE_INSERT);
+
 	if (isValidFrom) {
 		int rowFrom = indexFrom.row();
 		removeRow(rowFrom, parent);
 	}
 
-	if (isValidTo) {
-		::deserialize(this, item, row, parent);
+	insertChildren(parent, row, items);
+
+	return true;
+}
+
+bool TreeModel::deserialize(QIODevice* device, const QModelIndex& indexTo, bool checkOnly) {
+	QXmlStreamReader reader(device);
+	return deserialize(reader, indexTo, checkOnly);
+}
+
+bool TreeModel::deserialize(const QByteArray& data, const QModelIndex& indexTo, bool checkOnly) {
+	QXmlStreamReader reader(data);
+	return deserialize(reader, indexTo, checkOnly);
+}
+
+// snapshot
+////////////////////////////////////////////////////////////////////////////////////////////////////
+SnapshotTable TreeModel::snapshotTable(quint64 sequence) const {
+	TableBuilder builder(this);
+	builder.start(sequence);
+	while (!builder.step(std::numeric_limits<int>::max())) {}
+	return builder.take();
+}
+
+TreeModel::TableBuilder::TableBuilder(const TreeModel* model)
+	: model_(model),
+	changeCount_(0),
+	sequence_(0),
+	table_(),
+	entries_(),
+	parents_(),
+	next_(0),
+	dataSize_(0),
+	offsets_(),
+	snapshotOffsets_() {}
+
+void TreeModel::TableBuilder::start(quint64 sequence) {
+	changeCount_ = model_->changeCount_;
+	sequence_ = sequence;
+	table_ = SnapshotTable();
+	entries_ = QVector<Entry>(1, { model_->root_, -1 });
+	parents_ = QVector<qint32>(1, -1);
+	next_ = 0;
+	dataSize_ = 0;
+	offsets_.clear();
+	snapshotOffsets_.clear();
+}
+
+// entries are numbered in breadth-first order, children follow their parent's entries
+bool TreeModel::TableBuilder::step(int count) {
+	auto& snapshot = model_->snapshot_;
+	for (; count > 0 && next_ < entries_.size(); --count, ++next_) {
+		auto i = next_;
+		auto entry = entries_[i];
+
+		quint32 offset = 0;
+		quint32 size = 0;
+		if (entry.item) {
+			auto label = entry.item->label();
+			auto it = offsets_.find(label);
+			if (it == offsets_.end()) {
+				it = offsets_.insert(label, dataSize_);
+				table_.data.push_back(label->text);
+				dataSize_ += quint32(label->text.size());
+			}
+			offset = it.value();
+			size = quint32(label->text.size());
+		}
+		else {
+			auto& node = snapshot.node(entry.node);
+			auto key = (quint64(node.dataOffset) << 32) | node.dataSize;
+			auto it = snapshotOffsets_.find(key);
+			if (it == snapshotOffsets_.end()) {
+				it = snapshotOffsets_.insert(key, dataSize_);
+				table_.data.push_back(snapshot.rawData(entry.node));
+				dataSize_ += node.dataSize;
+			}
+			offset = it.value();
+			size = node.dataSize;
+		}
+
+		auto firstChild = entries_.size();
+		if (entry.item) {
+			auto childCount = entry.item->childCount();
+			for (int row = 0; row < childCount; ++row) {
+				entries_.push_back({ entry.item->child(row), -1 });
+			}
+		}
+
+		auto pendingNode = (entry.item) ? entry.item->pendingNode() : entry.node;
+		if (pendingNode != -1) {
+			auto& node = snapshot.node(pendingNode);
+			for (int child = 0; child < node.childCount; ++child) {
+				entries_.push_back({ nullptr, node.firstChild + child });
+			}
+		}
+
+		parents_.resize(entries_.size());
+		std::fill(parents_.begin() + firstChild, parents_.end(), i);
+
+		table_.nodes.push_back({ parents_[i], firstChild, entries_.size() - firstChild, offset, size });
 	}
-	else {
-		::deserialize(this, item);
+
+	if (next_ < entries_.size()) {
+		return false;
 	}
-	
+
+	table_.header = {
+		SnapshotHeader::MAGIC,
+		SnapshotHeader::VERSION,
+		quint32(table_.nodes.size()),
+		dataSize_,
+		sequence_
+	};
 	return true;
 }
+
+SnapshotTable TreeModel::TableBuilder::take() {
+	SnapshotTable table;
+	std::swap(table, table_);
+	entries_.clear();
+	parents_.clear();
+	offsets_.clear();
+	snapshotOffsets_.clear();
+	return table;
+}
+
+bool TreeModel::writeSnapshot(QIODevice* device, quint64 sequence) const {
+	return snapshotTable(sequence).write(device);
+}
+
+bool TreeModel::readSnapshot(const uchar* data, qint64 size) {
+	InstrumentationTimer timer(Instrumentation::SNAPSHOT_READ);
+	SnapshotView snapshot;
+	if (!snapshot.open(data, size)) {
+		qWarning() << "invalid snapshot";
+		return false;
+	}
+
+	auto items = storage_.create();
+	QVector<TreeItem*> nodeItems(snapshot.nodeCount(), nullptr);
+	nodeItems[0] = items;
+
+	// equal labels share data in snapshot, so they are interned once
+	QHash<quint64, const Label*> labels;
+	for (int i = 1; i < snapshot.nodeCount(); ++i) {
+		auto& node = snapshot.node(i);
+		auto parentItem = nodeItems[node.parent];
+		if (!parentItem) {
+			continue;
+		}
+
+		auto key = (quint64(node.dataOffset) << 32) | node.dataSize;
+		auto label = labels.value(key, nullptr);
+		if (!label) {
+			label = storage_.labels().acquire(snapshot.data(i));
+			labels.insert(key, label);
+		}
+
+		auto row = parentItem->childCount();
+		if (parentItem->insertChildren(storage_, label, row)) {
+			nodeItems[i] = parentItem->child(row);
+		}
+	}
+
+	for (auto label : labels) {
+		storage_.labels().release(label);
+	}
+
+	insertChildren(QModelIndex(), 0, items);
+
+	return true;
+}
+
+bool TreeModel::readSnapshot(QFile* file) {
+	auto size = file->size();
+	auto data = file->map(0, size);
+	if (data) {
+		auto isRead = readSnapshot(data, size);
+		file->unmap(data);
+		return isRead;
+	}
+
+	auto bytes = file->readAll();
+	return readSnapshot(reinterpret_cast<const uchar*>(bytes.constData()), bytes.size());
+}
@@ -2,15 +2,44 @@
 #define TREEMODEL_H
 
 #include <QAbstractItemModel>
+#include <QFile>
 #include <QModelIndex>
+#include <QFuture>
 #include <QVariant>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
 
+#include "instrumentation.h"
+#include "snapshotindex.h"
 #include "treeitem.h"
+#include "treesnapshot.h"
+#include "trigramindex.h"
 
 class TreeModel : public QAbstractItemModel
 {
     Q_OBJECT
 
+public:
+	// node of a subtree in pre-order, depth is counted from the inserted rows
+	struct Node {
+		QString data;
+		int depth;
+	};
+
+	// result of search in other thread: labels of loaded items and unloaded
+	// snapshot nodes, which data contains the text, with the labels of nodes
+	struct Matches {
+		QVector<QString> labels;
+		QVector<int> nodes;
+	};
+
+	// the most of snapshot nodes, which are fetched for one search text,
+	// texts shorter than a trigram match most of labels, so they fetch less
+	enum { FETCH_LIMIT = 10000 };
+	enum { SHORT_FETCH_LIMIT = 1000 };
+
+	class TableBuilder;
+
 public:
     explicit TreeModel(QObject* parent = 0);
     ~TreeModel();
@@ -24,16 +53,42 @@ public:
 
 	QModelIndex index(const QString& data, 
 		const QModelIndex& parent = QModelIndex() ) const {
-		auto row = item(parent)->index(data);
+		auto row = item(parent)->index(storage_.label(data));
 		return (row != -1) ? index(row, 0, parent) : QModelIndex();
 	}
 
+	// true, while children loaded from snapshot are inserted
+	bool isFetching() const {
+		return fetching_;
+	}
+
+	// rows first..last of parent with all their descendants
+	QVector<Node> subtree(const QModelIndex& parent, int first, int last) const;
+
+	QModelIndex indexOf(TreeItem* item) const {
+		return (item && item != root_)
+			? createIndex(item->row(), 0, item)
+			: QModelIndex();
+	}
+
 	QModelIndex insert(
 		const QString& data, 
 		int row, 
 		const QModelIndex& parent = QModelIndex()
 	);
 
+	bool insertBatch(
+		const QModelIndex& parent,
+		int row,
+		const QStringList& data
+	);
+
+	bool insertSubtree(
+		const QModelIndex& parent,
+		int row,
+		const QVector<Node>& nodes
+	);
+
     QVariant data(const QModelIndex& index, int role) const Q_DECL_OVERRIDE;
 
     QModelIndex index(int row, int column,
@@ -44,6 +99,12 @@ public:
     int rowCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
 
     int columnCount(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
+
+	bool hasChildren(const QModelIndex& parent = QModelIndex()) const Q_DECL_OVERRIDE;
+
+	bool canFetchMore(const QModelIndex& parent) const Q_DECL_OVERRIDE;
+
+	void fetchMore(const QModelIndex& parent) Q_DECL_OVERRIDE;
 	
 	Qt::ItemFlags flags(const QModelIndex &index) const Q_DECL_OVERRIDE;
 
@@ -83,9 +144,85 @@ public:
 
 	QByteArray serialize(const QModelIndex& root = QModelIndex()) const;
 
+	bool serialize(QIODevice* device, const QModelIndex& root = QModelIndex()) const;
+
 	bool deserialize(const QByteArray& data, const QModelIndex& indexTo = QModelIndex(), bool checkOnly = false);
 
+	bool deserialize(QIODevice* device, const QModelIndex& indexTo = QModelIndex(), bool checkOnly = false);
+
+	bool writeSnapshot(QIODevice* device, quint64 sequence = 0) const;
+
+	// tables of snapshot, which can be written in other thread, data of
+	// unloaded items refer to the mapped snapshot, which stays open;
+	// TableBuilder makes them in steps
+	SnapshotTable snapshotTable(quint64 sequence = 0) const;
+
+	bool readSnapshot(QFile* file);
+
+	bool readSnapshot(const uchar* data, qint64 size);
+
+	// open snapshot in lazy mode: only top level items are loaded,
+	// children are loaded from the mapped file by fetchMore,
+	// the loaded snapshot is kept, if top level items are not unique
+	bool openSnapshot(const QString& fileName);
+
+	// matches of text by the search index and by the index of snapshot,
+	// it may be called in other thread, while the model is changed, but
+	// not while a snapshot is opened; a canceled search stops between index probes
+	Matches findMatches(const QString& text, const SearchToken& token = SearchToken()) const;
+
+	// load unloaded snapshot nodes, e.g. found by findMatches, and their parents
+	void fetchNodes(const QVector<int>& nodes);
+
+	// load unloaded items with labels, e.g. ranked by fuzzy search
+	void fetchLabels(const QVector<QString>& labels);
+
+	// index of loaded items for substring search, disabled by default
+	void setSearchIndexEnabled(bool isEnabled);
+
+	// items, which data contains text case insensitive or is empty,
+	// false, if search index is disabled
+	bool findIndexes(const QString& text, QModelIndexList* indexes) const;
+
+	// items with labels or empty data, false, if search index is disabled
+	bool findIndexes(const QVector<QString>& labels, QModelIndexList* indexes) const;
+
+	// compares data of items by collation keys, which are cached per label,
+	// negative, if left is less than right
+	int compare(const QModelIndex& left, const QModelIndex& right) const;
+
+	void setCollator(const QCollator& collator);
+
+	// labels of loaded items with number of their items, they are copied from
+	// the search index, so it may be called in other thread, while the model
+	// is changed; empty, while the search index is disabled
+	QVector<Label> labelSnapshot() const;
+
+	// distinct labels of snapshot with number of their nodes,
+	// empty, while the index of snapshot is built
+	QVector<Label> snapshotLabels() const;
+
 private:
+	void fetch(const QModelIndex& parent);
+
+	void fetchPath(int node);
+
+	void readPending(TreeItem* items, int node);
+
+	void readPending(const SnapshotView& snapshot, TreeItem* items, int node, QHash<int, TreeItem*>* pending);
+
+	void removePending(TreeItem* item);
+
+	void addToSearchIndex(TreeItem* item);
+
+	void removeFromSearchIndex(TreeItem* item);
+
+	bool deserialize(QXmlStreamReader& reader, const QModelIndex& indexTo, bool checkOnly);
+
+	// children of "from" are moved to parent at pos, except the ones with data
+	// of children of parent, "from" is destroyed
+	bool insertChildren(const QModelIndex& parent, int pos, TreeItem* from);
+
 	bool dropMimeData_helper(
 		const QMimeData *data,
 		Qt::DropAction action,
@@ -95,7 +232,55 @@ private:
 	);
 
 private:
+	TreeStorage storage_;
 	TreeItem* root_;
+	QScopedPointer<QFile> snapshotFile_;
+	SnapshotView snapshot_;
+	QHash<int, TreeItem*> pending_;
+	QScopedPointer<SnapshotIndex> snapshotIndex_;
+	QFuture<void> snapshotIndexBuild_;
+	bool fetching_;
+	QScopedPointer<TrigramIndex<TreeItem>> searchIndex_;
+	quint64 changeCount_;
+};
+
+// Tables of snapshot, which are built in steps, so the event loop runs
+// between them. Items and snapshot nodes are read by the steps, so the
+// table is valid only while the model is not changed since start().
+class TreeModel::TableBuilder
+{
+public:
+	explicit TableBuilder(const TreeModel* model);
+
+	void start(quint64 sequence);
+
+	// false, if the model is changed since start
+	bool isValid() const {
+		return changeCount_ == model_->changeCount_;
+	}
+
+	// count entries are added to the table, true, when it is complete
+	bool step(int count);
+
+	SnapshotTable take();
+
+private:
+	// loaded item or, if item is null, node of the current snapshot
+	struct Entry {
+		const TreeItem* item;
+		int node;
+	};
+
+	const TreeModel* model_;
+	quint64 changeCount_;
+	quint64 sequence_;
+	SnapshotTable table_;
+	QVector<Entry> entries_;
+	QVector<qint32> parents_;
+	int next_;
+	quint32 dataSize_;
+	QHash<const Label*, quint32> offsets_;
+	QHash<quint64, quint32> snapshotOffsets_;
 };
 
 #endif // TREEMODEL_H
@@ -0,0 +1,134 @@
+#ifndef TREESNAPSHOT_H
+#define TREESNAPSHOT_H
+
+#include <QtCore>
+
+#include "instrumentation.h"
+
+// Binary snapshot of tree:
+// header, table of nodes in breadth-first order, UTF-16 data of labels.
+// Node 0 is the root, children of a node are contiguous in the table,
+// equal labels share the same data.
+struct SnapshotHeader {
+	enum { MAGIC = 0x53544243, VERSION = 2 };
+
+	quint32 magic;
+	quint32 version;
+	quint32 nodeCount;
+	quint32 dataSize;
+	quint64 sequence; // last journal record included in snapshot
+};
+
+struct SnapshotNode {
+	qint32 parent;
+	qint32 firstChild;
+	qint32 childCount;
+	quint32 dataOffset;
+	quint32 dataSize;
+};
+
+// Snapshot as tables in memory.
+// Data are shared with the labels of the tree, so the table is made fast
+// and may be written in other thread, while the tree is changed.
+struct SnapshotTable {
+	SnapshotHeader header;
+	QVector<SnapshotNode> nodes;
+	QVector<QString> data; // distinct data in the order of their offsets
+
+	bool write(QIODevice* device) const {
+		InstrumentationTimer timer(Instrumentation::SNAPSHOT_WRITE);
+		if (!writeRaw(device, &header, sizeof(header))
+			|| !writeRaw(device, nodes.constData(), nodes.size() * sizeof(SnapshotNode))) {
+			return false;
+		}
+
+		for (auto& text : data) {
+			if (!writeRaw(device, text.constData(), text.size() * sizeof(QChar))) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	static bool writeRaw(QIODevice* device, const void* data, qint64 size) {
+		return device->write(reinterpret_cast<const char*>(data), size) == size;
+	}
+};
+
+// read only view of snapshot in memory, e.g. of mapped file
+class SnapshotView
+{
+public:
+	SnapshotView() : header_(nullptr), nodes_(nullptr), data_(nullptr) {}
+
+	bool open(const uchar* data, qint64 size) {
+		header_ = nullptr;
+
+		auto header = reinterpret_cast<const SnapshotHeader*>(data);
+		if (!data || size < qint64(sizeof(SnapshotHeader))
+			|| header->magic != SnapshotHeader::MAGIC
+			|| header->version != SnapshotHeader::VERSION
+			|| header->nodeCount == 0) {
+			return false;
+		}
+
+		auto nodesSize = qint64(header->nodeCount) * qint64(sizeof(SnapshotNode));
+		auto dataSize = qint64(header->dataSize) * qint64(sizeof(QChar));
+		if (size < qint64(sizeof(SnapshotHeader)) + nodesSize + dataSize) {
+			return false;
+		}
+
+		auto nodes = reinterpret_cast<const SnapshotNode*>(data + sizeof(SnapshotHeader));
+		for (quint32 i = 0; i < header->nodeCount; ++i) {
+			auto& node = nodes[i];
+			bool isValidParent = (i == 0)
+				? node.parent == -1
+				: node.parent >= 0 && quint32(node.parent) < i;
+			if (!isValidParent
+				|| node.firstChild < 0 || node.childCount < 0
+				|| quint64(node.firstChild) + quint64(node.childCount) > header->nodeCount
+				|| quint64(node.dataOffset) + node.dataSize > header->dataSize) {
+				return false;
+			}
+		}
+
+		header_ = header;
+		nodes_ = nodes;
+		data_ = reinterpret_cast<const QChar*>(data + sizeof(SnapshotHeader) + nodesSize);
+		return true;
+	}
+
+	bool isValid() const {
+		return header_ != nullptr;
+	}
+
+	quint64 sequence() const {
+		return (header_) ? header_->sequence : 0;
+	}
+
+	int nodeCount() const {
+		return (header_) ? int(header_->nodeCount) : 0;
+	}
+
+	const SnapshotNode& node(int index) const {
+		return nodes_[index];
+	}
+
+	QString data(int index) const {
+		auto& node = nodes_[index];
+		return QString(data_ + node.dataOffset, int(node.dataSize));
+	}
+
+	// data without copy, valid while snapshot memory is valid
+	QString rawData(int index) const {
+		auto& node = nodes_[index];
+		return QString::fromRawData(data_ + node.dataOffset, int(node.dataSize));
+	}
+
+private:
+	const SnapshotHeader* header_;
+	const SnapshotNode* nodes_;
+	const QChar* data_;
+};
+
+#endif // TREESNAPSHOT_H
@@ -11,16 +11,78 @@ TreeWidget::TreeWidget(QWidget *parent)
 	: QTreeView(parent),
 	sourceModel_(nullptr),
 	model_(nullptr),
-	itemDelegate_(nullptr)
+	itemDelegate_(nullptr),
+	journal_(nullptr),
+	searchTimer_(nullptr),
+	searchWatcher_(nullptr),
+	searchGeneration_(0),
+	labelsWatcher_(nullptr),
+	rankWatcher_(nullptr),
+	searchMode_(SUBSTRING_SEARCH),
+	fuzzyLimit_(FUZZY_LIMIT),
+	searchText_(),
+	runningSearchText_(),
+	searchLabels_(),
+	searchMatches_(0),
+	tableBuilder_(),
+	tableTimer_(nullptr)
 {
 	sourceModel_ = new TreeModel(this);
+	sourceModel_->setSearchIndexEnabled(true);
+
 	model_ = new SortFilterProxyModel(sourceModel_);
 	model_->setSourceModel(sourceModel_);
+	model_->setCandidateFinder([this](const QRegExp& regExp, QModelIndexList* indexes) {
+		if (regExp.patternSyntax() != QRegExp::FixedString) {
+			return false;
+		}
+
+		// labels found by the search in other thread
+		auto isFound = (!searchLabels_.isEmpty() && regExp.pattern() == runningSearchText_)
+			? sourceModel_->findIndexes(searchLabels_, indexes)
+			: sourceModel_->findIndexes(regExp.pattern(), indexes);
+		searchMatches_ = indexes->size();
+		return isFound;
+	});
+	model_->setComparator([this](const QModelIndex& left, const QModelIndex& right) {
+		return sourceModel_->compare(left, right);
+	});
+
+	searchTimer_ = new QTimer(this);
+	searchTimer_->setSingleShot(true);
+	searchTimer_->setInterval(SEARCH_DELAY);
+	QObject::connect(searchTimer_, &QTimer::timeout, this, &TreeWidget::startSearch);
+
+	tableBuilder_.reset(new TreeModel::TableBuilder(sourceModel_));
+	tableTimer_ = new QTimer(this);
+	tableTimer_->setInterval(0);
+	QObject::connect(tableTimer_, &QTimer::timeout, this, &TreeWidget::buildSnapshotStep);
+
+	searchWatcher_ = new QFutureWatcher<TreeModel::Matches>(this);
+	QObject::connect(searchWatcher_, &QFutureWatcher<TreeModel::Matches>::finished,
+		this, &TreeWidget::searchFinished);
+
+	labelsWatcher_ = new QFutureWatcher<QVector<Label>>(this);
+	QObject::connect(labelsWatcher_, &QFutureWatcher<QVector<Label>>::finished,
+		this, &TreeWidget::labelsFinished);
+
+	rankWatcher_ = new QFutureWatcher<FuzzyRanking>(this);
+	QObject::connect(rankWatcher_, &QFutureWatcher<FuzzyRanking>::progressValueChanged,
+		[this](int progress) {
+			emit searchProgress(progress, rankWatcher_->progressMaximum(), searchMatches_);
+		}
+	);
+	QObject::connect(rankWatcher_, &QFutureWatcher<FuzzyRanking>::finished,
+		this, &TreeWidget::rankFinished);
 	model_->setFilterFixedString({});
 	model_->setFilterCaseSensitivity(Qt::CaseInsensitive);
 	model_->setFilterKeyColumn(0);
 	setModel(model_);
 
+	// all rows have the same font and buttons, so the view takes the height
+	// of one row instead of the size hint of each row
+	setUniformRowHeights(true);
+
 	itemDelegate_ = new ButtonsDelegate(buttonsIconSize(), this);
 	QObject::connect(itemDelegate_, &ButtonsDelegate::removeClicked,
 		[this](const QModelIndex& index) { this->removeRow(index.row(), index.parent()); }
@@ -34,7 +96,53 @@ TreeWidget::TreeWidget(QWidget *parent)
 	setItemDelegate(itemDelegate_);
 }
 
-TreeWidget::~TreeWidget() {}
+// a running search reads the model, so it is finished before the model is destroyed
+TreeWidget::~TreeWidget() {
+	searchGeneration_.ref();
+	searchWatcher_->cancel();
+	labelsWatcher_->cancel();
+	rankWatcher_->cancel();
+	searchWatcher_->waitForFinished();
+	labelsWatcher_->waitForFinished();
+}
+
+int TreeWidget::searchDelay() const {
+	return searchTimer_->interval();
+}
+
+void TreeWidget::setSearchDelay(int msec) {
+	searchTimer_->setInterval(msec);
+}
+
+TreeWidget::SearchMode TreeWidget::searchMode() const {
+	return searchMode_;
+}
+
+void TreeWidget::setSearchMode(SearchMode mode) {
+	if (searchMode_ == mode) {
+		return;
+	}
+
+	searchMode_ = mode;
+	search(searchText_);
+}
+
+int TreeWidget::fuzzyLimit() const {
+	return fuzzyLimit_;
+}
+
+void TreeWidget::setFuzzyLimit(int limit) {
+	fuzzyLimit_ = limit;
+}
+
+void TreeWidget::setFuzzySearch(bool isFuzzy) {
+	setSearchMode((isFuzzy) ? FUZZY_SEARCH : SUBSTRING_SEARCH);
+}
+
+// items are sorted by the collation keys of model, unsorted items keep their order
+void TreeWidget::setSortedByName(bool isSorted) {
+	model_->sort((isSorted) ? 0 : -1, Qt::AscendingOrder);
+}
 
 void TreeWidget::closeEditor() {
 	setEnabled(!isEnabled());
@@ -49,9 +157,12 @@ void TreeWidget::insertRow(int row, const QModelIndex& parent) {
 		sourceModel_->index(QString(), model_->mapToSource(parent))
 	);
 
+	// a sorted proxy does not keep the new item at row
 	if (!editIndex.isValid()) {
 		model_->insertRow(row, parent);
-		editIndex = model_->index(row, 0, parent);
+		editIndex = model_->mapFromSource(
+			sourceModel_->index(QString(), model_->mapToSource(parent))
+		);
 	}
 
 	if (parent.isValid()) {
@@ -71,22 +182,216 @@ void TreeWidget::removeRow(int row, const QModelIndex& parent) {
 	model_->removeRow(row, parent);
 }
 
+// search starts, when text is not changed during search delay,
+// a newer text cancels the running search, which stops at its next index probe
 void TreeWidget::search(const QString& searchText) {
+	searchText_ = searchText;
+	searchGeneration_.ref();
+	searchWatcher_->cancel();
+	labelsWatcher_->cancel();
+	rankWatcher_->cancel();
+	searchTimer_->start();
+}
+
+// loaded labels and unloaded nodes are found by the indexes of model in other thread
+void TreeWidget::startSearch() {
+	if (searchText_.isEmpty()) {
+		searchMatches_ = 0;
+		applySearch(searchText_, {});
+		return;
+	}
+
+	runningSearchText_ = searchText_;
+	searchMatches_ = 0;
+
+	// labels of loaded items are copied from the search index in other thread
+	if (searchMode_ == FUZZY_SEARCH) {
+		labelsWatcher_->setFuture(QtConcurrent::run(sourceModel_, &TreeModel::labelSnapshot));
+		return;
+	}
+
+	searchWatcher_->setFuture(QtConcurrent::run(
+		sourceModel_, &TreeModel::findMatches, searchText_, SearchToken(&searchGeneration_)));
+}
+
+// found nodes are fetched, before their labels are applied
+void TreeWidget::searchFinished() {
+	if (searchWatcher_->isCanceled() || searchWatcher_->future().resultCount() == 0) {
+		return;
+	}
+
+	auto matches = searchWatcher_->result();
+	sourceModel_->fetchNodes(matches.nodes);
+	applySearch(runningSearchText_, matches.labels);
+}
+
+// labels of loaded items and of snapshot are ranked in parallel,
+// the best ones of each range are merged; the labels of snapshot are shared
+void TreeWidget::labelsFinished() {
+	if (labelsWatcher_->isCanceled() || labelsWatcher_->future().resultCount() == 0) {
+		return;
+	}
+
+	rankWatcher_->setFuture(rankLabels(
+		runningSearchText_,
+		{ labelsWatcher_->result(), sourceModel_->snapshotLabels() },
+		fuzzyLimit_
+	));
+}
+
+// ranked labels are fetched from snapshot and shown with all their items,
+// nothing is shown, if no label is ranked
+void TreeWidget::rankFinished() {
+	if (rankWatcher_->isCanceled()) {
+		return;
+	}
+
+	QVector<QString> labels;
+	if (rankWatcher_->future().resultCount() > 0) {
+		for (auto& match : rankWatcher_->result().matches()) {
+			labels.push_back(match.text);
+		}
+	}
+
+	QModelIndexList indexes;
+	if (!labels.isEmpty()) {
+		sourceModel_->fetchLabels(labels);
+		sourceModel_->findIndexes(labels, &indexes);
+	}
+	searchMatches_ = indexes.size();
+
+	model_->setRankedFilter(runningSearchText_, indexes);
+	expandIndexes(model_->indexesExpand());
+
+	auto maximum = rankWatcher_->progressMaximum();
+	emit searchProgress(maximum, maximum, searchMatches_);
+}
+
+// matched labels are applied to proxy in one update, the proxy is rebuilt
+// on this thread, as views read it, but only candidates of the labels are checked
+void TreeWidget::applySearch(const QString& searchText, const QVector<QString>& labels) {
+	model_->clearRankedFilter();
+	searchLabels_ = labels;
 	model_->setFilterFixedString(searchText);
+	searchLabels_.clear();
+
 	if (!searchText.isEmpty()) {
-		for (auto& expandIndex : model_->indexesExpand()) {
-			expand(expandIndex);
-		}
+		expandIndexes(model_->indexesExpand());
+	}
+
+	// the indexes are searched in one step
+	emit searchProgress(1, 1, searchMatches_);
+}
+
+// indexes are only stored as expanded, while a layout is pending,
+// so the tree is laid out once for all of them
+void TreeWidget::expandIndexes(const QModelIndexList& indexes) {
+	if (indexes.isEmpty()) {
+		return;
+	}
+
+	setUpdatesEnabled(false);
+	scheduleDelayedItemsLayout();
+	for (auto& index : indexes) {
+		expand(index);
 	}
+	executeDelayedItemsLayout();
+	setUpdatesEnabled(true);
 }
 
 QByteArray TreeWidget::serialize() const {
 	return sourceModel_->serialize();
 }
 
+bool TreeWidget::serialize(QIODevice* device) const {
+	return sourceModel_->serialize(device);
+}
+
 void TreeWidget::deserialize(const QByteArray& data) {
 	sourceModel_->deserialize(data);
 	if (sourceModel_->rowCount() <= 0) {
 		sourceModel_->insertRow(0);
 	}
 }
+
+void TreeWidget::deserialize(QIODevice* device) {
+	sourceModel_->deserialize(device);
+	if (sourceModel_->rowCount() <= 0) {
+		sourceModel_->insertRow(0);
+	}
+}
+
+bool TreeWidget::writeSnapshot(QIODevice* device) const {
+	return sourceModel_->writeSnapshot(device, journalSequence());
+}
+
+// journal is marked at the last record in the table, so it can be compacted,
+// when the table is written; the table is built in steps between events,
+// as the model is read in the GUI thread only
+void TreeWidget::buildSnapshotTable() {
+	auto sequence = (journal_) ? journal_->mark() : 0;
+	tableBuilder_->start(sequence);
+	tableTimer_->start();
+}
+
+bool TreeWidget::isBuildingSnapshotTable() const {
+	return tableTimer_->isActive();
+}
+
+// a change of the model restarts the table, so the journal is marked again
+void TreeWidget::buildSnapshotStep() {
+	if (!tableBuilder_->isValid()) {
+		auto sequence = (journal_) ? journal_->mark() : 0;
+		tableBuilder_->start(sequence);
+	}
+
+	if (tableBuilder_->step(TABLE_STEP)) {
+		tableTimer_->stop();
+		emit snapshotTableBuilt(tableBuilder_->take());
+	}
+}
+
+bool TreeWidget::readSnapshot(QFile* file) {
+	if (!sourceModel_->readSnapshot(file)) {
+		return false;
+	}
+
+	if (sourceModel_->rowCount() <= 0) {
+		sourceModel_->insertRow(0);
+	}
+	return true;
+}
+
+// a running search reads the index of the old snapshot
+bool TreeWidget::openSnapshot(const QString& fileName) {
+	searchGeneration_.ref();
+	searchWatcher_->cancel();
+	searchWatcher_->waitForFinished();
+
+	if (!sourceModel_->openSnapshot(fileName)) {
+		return false;
+	}
+
+	if (sourceModel_->rowCount() <= 0) {
+		sourceModel_->insertRow(0);
+	}
+	return true;
+}
+
+bool TreeWidget::openJournal(const QString& fileName, quint64 sequence) {
+	delete journal_;
+	journal_ = new TreeJournal(sourceModel_, this);
+	return journal_->open(fileName, sequence);
+}
+
+quint64 TreeWidget::journalSequence() const {
+	return (journal_) ? journal_->sequence() : 0;
+}
+
+bool TreeWidget::compactJournal() {
+	return journal_ && journal_->compact();
+}
+
+bool TreeWidget::syncJournal() {
+	return journal_ && journal_->sync();
+}
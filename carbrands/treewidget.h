@@ -2,8 +2,11 @@
 #define TREEWIDGET_H
 
 #include <QtWidgets>
+#include <QtConcurrent>
 
+#include "fuzzymatcher.h"
 #include "treemodel.h"
+#include "treejournal.h"
 #include "sortfilterproxymodel.h"
 #include "buttonsdelegate.h"
 
@@ -11,22 +14,86 @@ class TreeWidget : public QTreeView
 {
 	Q_OBJECT
 
+public:
+	enum { SEARCH_DELAY = 200 };
+	enum { FUZZY_LIMIT = 100 };
+	enum { TABLE_STEP = 10000 };
+
+	// substring search shows all items, which contain text,
+	// fuzzy search shows the best ranked items only
+	enum SearchMode { SUBSTRING_SEARCH, FUZZY_SEARCH };
+
 public:
 	TreeWidget(QWidget *parent = 0);
 	~TreeWidget();
 
+	// delay between the last change of search text and the search
+	int searchDelay() const;
+	void setSearchDelay(int msec);
+
+	SearchMode searchMode() const;
+	void setSearchMode(SearchMode mode);
+
+	// number of items shown by fuzzy search, the items of the worst shown
+	// label may exceed it
+	int fuzzyLimit() const;
+	void setFuzzyLimit(int limit);
+
+signals:
+	// matches is the number of items with matched labels found so far
+	void searchProgress(int progress, int maximum, int matches);
+	void snapshotTableBuilt(const SnapshotTable& table);
+
 public slots:
 	void closeEditor();
 	void insertRow(int row, const QModelIndex& parent = QModelIndex());
 	void removeRow(int row, const QModelIndex& parent = QModelIndex());
 	void search(const QString& searchText);
+	void setFuzzySearch(bool isFuzzy);
+	void setSortedByName(bool isSorted);
 	QByteArray serialize() const;
+	bool serialize(QIODevice* device) const;
 	void deserialize(const QByteArray& data);
+	void deserialize(QIODevice* device);
+	bool writeSnapshot(QIODevice* device) const;
+	void buildSnapshotTable();
+	bool isBuildingSnapshotTable() const;
+	bool readSnapshot(QFile* file);
+	bool openSnapshot(const QString& fileName);
+	bool openJournal(const QString& fileName, quint64 sequence);
+	quint64 journalSequence() const;
+	bool compactJournal();
+	bool syncJournal();
+
+private slots:
+	void startSearch();
+	void searchFinished();
+	void labelsFinished();
+	void rankFinished();
+	void buildSnapshotStep();
+
+private:
+	void applySearch(const QString& searchText, const QVector<QString>& labels);
+	void expandIndexes(const QModelIndexList& indexes);
 
 private:
 	TreeModel* sourceModel_;
 	SortFilterProxyModel* model_;
 	ButtonsDelegate* itemDelegate_;
+	TreeJournal* journal_;
+	QTimer* searchTimer_;
+	QFutureWatcher<TreeModel::Matches>* searchWatcher_;
+	QAtomicInt searchGeneration_;
+	QFutureWatcher<QVector<Label>>* labelsWatcher_;
+	QFutureWatcher<FuzzyRanking>* rankWatcher_;
+	SearchMode searchMode_;
+	int fuzzyLimit_;
+	QString searchText_;
+	QString runningSearchText_;
+	QVector<QString> searchLabels_;
+	int searchMatches_;
+	QScopedPointer<TreeModel::TableBuilder> tableBuilder_;
+	QTimer* tableTimer_;
 };
 
 #endif // TREEWIDGET_H
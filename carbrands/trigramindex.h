@@ -0,0 +1,182 @@
+#ifndef TRIGRAMINDEX_H
+#define TRIGRAMINDEX_H
+
+#include <QtCore>
+
+#include "labeltable.h"
+#include "textmatcher.h"
+
+// keys of trigrams of case folded code points of text, which are folded
+// as TextMatcher folds them, so a surrogate pair is one code point
+inline QSet<quint64> trigramKeys(const QString& text) {
+	enum { CODE_BITS = 21 };
+
+	QSet<quint64> keys;
+	auto codes = TextMatcher::fold(text);
+	for (int i = 0; i + 3 <= codes.size(); ++i) {
+		keys.insert((quint64(codes[i]) << (2 * CODE_BITS))
+			| (quint64(codes[i + 1]) << CODE_BITS)
+			| quint64(codes[i + 2]));
+	}
+	return keys;
+}
+
+// Token of a search in other thread: the search is canceled, when the
+// generation it was started with changes. A default token is never canceled.
+class SearchToken
+{
+public:
+	SearchToken() : generation_(nullptr), value_(0) {}
+
+	explicit SearchToken(const QAtomicInt* generation)
+		: generation_(generation), value_(generation->loadAcquire()) {}
+
+	bool isCanceled() const {
+		return generation_ && generation_->loadAcquire() != value_;
+	}
+
+private:
+	const QAtomicInt* generation_;
+	int value_;
+};
+
+// Inverted index of items by trigrams of their case folded labels.
+// A label is indexed while at least one item uses it. A query takes the
+// labels of its rarest trigram and checks only them by TextMatcher,
+// queries shorter than a trigram check every indexed label.
+// The index is changed by one thread and can be searched by others,
+// a label is not released, while it is indexed.
+//
+// T must have a method "const Label* label() const".
+template <typename T>
+class TrigramIndex
+{
+public:
+	TrigramIndex() : lock_(), trigrams_(), items_() {}
+
+	void insert(T* item) {
+		QWriteLocker locker(&lock_);
+		auto label = item->label();
+		auto& items = items_[label];
+		if (items.isEmpty()) {
+			for (auto trigram : trigramKeys(label->text)) {
+				trigrams_[trigram].insert(label);
+			}
+		}
+		items.insert(item);
+	}
+
+	void remove(T* item) {
+		QWriteLocker locker(&lock_);
+		auto label = item->label();
+		auto it = items_.find(label);
+		if (it == items_.end()) {
+			return;
+		}
+
+		it.value().remove(item);
+		if (!it.value().isEmpty()) {
+			return;
+		}
+		items_.erase(it);
+
+		for (auto trigram : trigramKeys(label->text)) {
+			auto labels = trigrams_.find(trigram);
+			if (labels != trigrams_.end()) {
+				labels.value().remove(label);
+				if (labels.value().isEmpty()) {
+					trigrams_.erase(labels);
+				}
+			}
+		}
+	}
+
+	// items, which label contains text, case insensitive
+	QVector<T*> find(const QString& text) const {
+		QReadLocker locker(&lock_);
+		QVector<T*> found;
+		match(text, [this, &found](const Label* label) { append(found, items_.value(label)); });
+		return found;
+	}
+
+	// copies of labels, which contain text case insensitive, e.g. for search in other thread,
+	// a canceled search stops between labels
+	QVector<QString> findLabels(const QString& text, const SearchToken& token = SearchToken()) const {
+		QReadLocker locker(&lock_);
+		QVector<QString> found;
+		match(text, [&found](const Label* label) { found.push_back(label->text); }, token);
+		return found;
+	}
+
+	// copies of indexed labels with the number of their items, e.g. for search in other thread
+	QVector<Label> labels() const {
+		QReadLocker locker(&lock_);
+		QVector<Label> labels;
+		labels.reserve(items_.size());
+		for (auto it = items_.begin(); it != items_.end(); ++it) {
+			labels.push_back({ it.key()->text, it.value().size() });
+		}
+		return labels;
+	}
+
+	// items with label
+	QVector<T*> items(const Label* label) const {
+		QReadLocker locker(&lock_);
+		QVector<T*> found;
+		append(found, items_.value(label));
+		return found;
+	}
+
+private:
+	Q_DISABLE_COPY(TrigramIndex)
+
+	template <typename Visit>
+	void match(const QString& text, Visit visit, const SearchToken& token = SearchToken()) const {
+		TextMatcher matcher(text);
+
+		auto keys = trigramKeys(text);
+		if (keys.isEmpty()) {
+			for (auto it = items_.begin(); it != items_.end() && !token.isCanceled(); ++it) {
+				if (matcher.contains(it.key()->text)) {
+					visit(it.key());
+				}
+			}
+			return;
+		}
+
+		const QSet<const Label*>* rarest = nullptr;
+		for (auto key : keys) {
+			auto it = trigrams_.find(key);
+			if (it == trigrams_.end()) {
+				return;
+			}
+
+			if (!rarest || it.value().size() < rarest->size()) {
+				rarest = &it.value();
+			}
+		}
+
+		for (auto label : *rarest) {
+			if (token.isCanceled()) {
+				return;
+			}
+
+			if (matcher.contains(label->text)) {
+				visit(label);
+			}
+		}
+	}
+
+	static void append(QVector<T*>& found, const QSet<T*>& items) {
+		for (auto item : items) {
+			found.push_back(item);
+		}
+	}
+
+private:
+	mutable QReadWriteLock lock_;
+	QHash<quint64, QSet<const Label*>> trigrams_;
+	QHash<const Label*, QSet<T*>> items_;
+};
+
+#endif // TRIGRAMINDEX_H
@@ -0,0 +1,23 @@
+# ----------------------------------------------------
+# Unit tests of the search, e.g.
+#   qmake carbrands.pro && make && Win32/Release/tests
+# ------------------------------------------------------
+
+TEMPLATE = app
+TARGET = tests
+DESTDIR = ../Win32/Release
+QT += core testlib
+CONFIG += release console testcase
+DEFINES += Q_COMPILER_INITIALIZER_LISTS WIN64 QT_DLL QT_TESTLIB_LIB
+INCLUDEPATH += ../carbrands \
+    ./GeneratedFiles \
+    ./GeneratedFiles/Release
+DEPENDPATH += ../carbrands
+MOC_DIR += ./GeneratedFiles/release
+OBJECTS_DIR += release
+HEADERS += ../carbrands/labeltable.h \
+    ../carbrands/objectpool.h \
+    ../carbrands/trigramindex.h \
+    ../carbrands/textmatcher.h
+SOURCES += ./tst_trigramindex.cpp \
+    ../carbrands/textmatcher.cpp
@@ -0,0 +1,76 @@
+#include <QtTest>
+
+#include "labeltable.h"
+#include "trigramindex.h"
+
+// item of the index, which uses a label of the table
+struct Item {
+	const Label* label_;
+
+	const Label* label() const {
+		return label_;
+	}
+};
+
+// text of code points, which are above the basic plane
+QString fromUcs4(std::initializer_list<uint> codes) {
+	QVector<uint> data(codes);
+	return QString::fromUcs4(data.constData(), data.size());
+}
+
+class TrigramIndexTest : public QObject
+{
+	Q_OBJECT
+
+private slots:
+	void keysOfSurrogatePairs();
+	void findSurrogatePairs();
+	void findSurrogatePairsInText();
+};
+
+// a surrogate pair is one code point of a trigram
+void TrigramIndexTest::keysOfSurrogatePairs() {
+	// deseret capital letters, their folds are other supplementary code points
+	auto upper = fromUcs4({ 0x10400, 0x10401, 0x10402 });
+	auto lower = fromUcs4({ 0x10428, 0x10429, 0x1042a });
+	QCOMPARE(upper.size(), 6);
+
+	QCOMPARE(trigramKeys(upper).size(), 1);
+	QCOMPARE(trigramKeys(upper), trigramKeys(lower));
+	QCOMPARE(trigramKeys(QString("ab") + upper.left(2)).size(), 1);
+}
+
+// labels are found by the case folded code points, as TextMatcher finds them
+void TrigramIndexTest::findSurrogatePairs() {
+	LabelTable labels;
+	Item upper = { labels.acquire(fromUcs4({ 0x10400, 0x10401, 0x10402 })) };
+	Item other = { labels.acquire(fromUcs4({ 0x10400, 0x10401, 0x10403 })) };
+
+	TrigramIndex<Item> index;
+	index.insert(&upper);
+	index.insert(&other);
+
+	auto found = index.find(fromUcs4({ 0x10428, 0x10429, 0x1042a }));
+	QCOMPARE(found.size(), 1);
+	QCOMPARE(found.front(), &upper);
+
+	QCOMPARE(index.find(fromUcs4({ 0x10428, 0x10429 })).size(), 2);
+}
+
+void TrigramIndexTest::findSurrogatePairsInText() {
+	LabelTable labels;
+	Item item = { labels.acquire(QString("Car ") + fromUcs4({ 0x10400, 0x10401 }) + QString(" Brand")) };
+
+	TrigramIndex<Item> index;
+	index.insert(&item);
+
+	QCOMPARE(index.findLabels(QString("r ") + fromUcs4({ 0x10428 })), QVector<QString>{ item.label()->text });
+	QCOMPARE(index.findLabels(fromUcs4({ 0x10429 }) + QString(" b")), QVector<QString>{ item.label()->text });
+	QVERIFY(index.findLabels(fromUcs4({ 0x10429 }) + QString(" c")).isEmpty());
+
+	index.remove(&item);
+	QVERIFY(index.findLabels(QString("r ") + fromUcs4({ 0x10428 })).isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TrigramIndexTest)
+#include "tst_trigramindex.moc"